@@ -0,0 +1,1255 @@
+/*
+    bench - headless benchmark for MarchingCubes::fillInTrianglesIndexed
+
+    Fills a VoxelField with one of the debug generators and measures how long
+    each phase takes: triangle table generation, field generation and extraction.
+    Extraction throughput is reported as cells/s, triangles/s and vertices/s.
+
+        mc-bench [options]
+
+            -s, --size N | X,Y,Z      grid size (default 64)
+            -i, --iterations N        timed iterations per scene (default 5)
+            -c, --scene NAME          spheres, perlin, ambiguous, zeroslice or all (default all)
+            -p, --phase F             animation phase used by the spheres scene (default 23.85)
+            -t, --threads N           use fillInTrianglesIndexedParallel with N threads, 0 = all cores
+            -2, --two-pass            count first and fill exactly sized buffers with fillInTrianglesIndexedCounted,
+                                      single threaded unless -t is given, the time includes both passes
+            -S, --stream              push the geometry to a counting sink with streamTrianglesIndexed
+            -a, --soa                 single threaded fill into MeshSoA, positions and normals in separate arrays
+            -q, --compact             fill CompactMesh with fillInTrianglesCompact, quantized positions and normals,
+                                      -v compares the decoded mesh with the reference and prints the largest errors
+            -T, --tiled N             generate each z layer in NxN cube tiles in Morton order instead of whole rows
+            -l, --layout NAME         field storage: linear, bricked keeps 8^3 samples together in Morton order,
+                                      paged keeps those bricks in a temporary file, sparse allocates only bricks
+                                      near the surface, use it with -b to skip the rest (default linear)
+            -P, --page-budget MB      memory for resident bricks of the paged layout (default 64)
+            -R, --raw FILE            write the generated field to FILE and extract from the file mapped with
+                                      VoxelField::openRaw, the field time is the time of opening it again
+            -e, --edit                keep a ChunkedMesh and time updateChunkedMesh after adding a small sphere
+                                      to the field, instead of generating the scene again every iteration
+            -L, --lod DIST            split the field into LodMesh chunks of 32 cubes with lods selected for an eye in the middle
+                                      of the z = 0 face, lod 0 up to DIST, up to lod 3 further away, -v counts cracks
+            -I, --iso V[,V...]        isovalue, with more values fillInTrianglesLevels extracts all of them in one pass
+                                      and the numbers are the sums over all levels (default 0)
+            -B, --batch N             copy the scene into separate fields of NxNxN cubes and generate them all with
+                                      fillInTrianglesBatch, on -t threads, the copying is counted as field time
+            -m, --cache full|rolling  vertex cache mode (default rolling)
+            -n, --normals triangles|gradient
+                                      sums of triangle normals or the interpolated field gradient (default triangles)
+            -b, --bricks              enable the min/max brick index of the field
+            -k, --kernel NAME         row classification: scalar, sse4, avx2 or auto (default auto)
+            -v, --verify              check the compile time triangle table against the runtime generator
+                                      and compare the mesh with the single threaded, full cache, no bricks, scalar reference
+
+    The 'ambiguous' and 'zeroslice' generators set their own tiny grid size,
+    the size option is ignored for them.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "VoxelField.h"
+#include "MarchingCubes.h"
+
+using namespace std;
+
+typedef chrono::steady_clock   BenchClock;
+
+static double msSince( BenchClock::time_point start )
+{
+	chrono::duration<double, milli> elapsed = BenchClock::now() - start;
+	return elapsed.count();
+}
+
+enum BenchScene {
+	SCENE_SPHERES = 0,
+	SCENE_PERLIN,
+	SCENE_AMBIGUOUS,
+	SCENE_ZEROSLICE,
+	SCENE_COUNT
+};
+
+static const char* sceneNames[SCENE_COUNT] = { "spheres", "perlin", "ambiguous", "zeroslice" };
+
+struct BenchOptions {
+	int		sizeX, sizeY, sizeZ;
+	int		iterations;
+	int		scene;			// -1 means all scenes
+	float	phase;
+	int		threads;		// -1 means single threaded fillInTrianglesIndexed
+	bool	twoPass;
+	bool	stream;
+	bool	soa;
+	bool	compact;
+	bool	edit;
+	bool	verify;
+	MarchingCubes::CacheMode	cacheMode;
+	MarchingCubes::NormalMode	normalMode;
+	bool	bricks;
+	MarchingCubes::ClassifyKernel	kernel;
+	int		tile;			// 0 means TRAVERSAL_ROWS
+	VoxelField::Layout	layout;
+	int		pageBudget;		// MB
+	const char*	raw;		// NULL unless the field is extracted from a raw file
+	float	lod;			// 0 means no LodMesh
+	vector<float>	isoValues;	// more than one means fillInTrianglesLevels
+	int		batch;			// 0 means the scene isn't split into fields for fillInTrianglesBatch
+};
+
+// generates the scene into the field
+static void generateScene( VoxelField& field, const BenchOptions& opt, int scene, int iteration )
+{
+	switch( scene ) {
+		case SCENE_SPHERES:
+			field.setSpheres( opt.phase + iteration );
+			break;
+		case SCENE_PERLIN:
+			field.setPerlinNoise( iteration );
+			break;
+		case SCENE_AMBIGUOUS:
+			field.setAmbiguousCase( iteration % 6 );
+			break;
+		case SCENE_ZEROSLICE:
+			field.setZeroSlice();
+			break;
+	}
+	// only a narrow band around the surfaces stays allocated, it's a no-op for other layouts
+	field.pruneSparse( opt.isoValues.empty() ? NULL : opt.isoValues.data(), (int)opt.isoValues.size(),
+					   opt.normalMode == MarchingCubes::NORMAL_GRADIENT ? 2 : 1 );
+}
+
+// a small edit somewhere in the field, the same sequence every run
+static void editScene( VoxelField& field, int iteration )
+{
+	unsigned int seed = 12345 + 7919 * iteration;
+	float pos[3];
+	int size[3] = { field.getSizeX(), field.getSizeY(), field.getSizeZ() };
+	for( int a = 0; a < 3; a++ ) {
+		seed = seed * 1103515245 + 12345;
+		pos[a] = (float)((seed >> 8) % size[a]);
+	}
+	field.addSphere( pos[0], pos[1], pos[2], 4.0f );
+}
+
+// writes the field to the raw file and maps it back, with -v the samples are compared with the written ones
+static bool openRawScene( VoxelField& field, const BenchOptions& opt )
+{
+	vector<float> values;
+	if( opt.verify ) {
+		values.resize( (size_t)field.getSizeX() * field.getSizeY() * field.getSizeZ() );
+		for( int z = 0, i = 0; z < field.getSizeZ(); z++ )
+		for( int y = 0; y < field.getSizeY(); y++ )
+		for( int x = 0; x < field.getSizeX(); x++ )
+			field.getVal( x,y,z, &values[i++] );
+	}
+
+	if( !field.saveRaw( opt.raw ) || !field.openRaw( opt.raw ) ) {
+		printf( "%s: can't write or open the raw file\n", opt.raw );
+		return false;
+	}
+
+	if( opt.verify ) {
+		for( int z = 0, i = 0; z < field.getSizeZ(); z++ )
+		for( int y = 0; y < field.getSizeY(); y++ )
+		for( int x = 0; x < field.getSizeX(); x++ ) {
+			float val;
+			field.getVal( x,y,z, &val );
+			if( memcmp( &val, &values[i++], sizeof(float) ) != 0 ) {
+				printf( "verify: raw file sample (%d,%d,%d) differs\n", x, y, z );
+				return false;
+			}
+		}
+
+		// saved in place over the file mapped as the field, then back to the generated values
+		for( int pass = 0; pass < 2; pass++ ) {
+			float val = pass ? values[0] : values[0] + 1.0f;
+			field.setVal( 0,0,0, val );
+			if( !field.saveRaw( opt.raw ) || !field.openRaw( opt.raw ) ) {
+				printf( "verify: raw file can't be saved over itself\n" );
+				return false;
+			}
+			float first, last;
+			field.getVal( 0,0,0, &first );
+			field.getVal( field.getSizeX()-1, field.getSizeY()-1, field.getSizeZ()-1, &last );
+			if( memcmp( &first, &val, sizeof(float) ) != 0 || memcmp( &last, &values.back(), sizeof(float) ) != 0 ) {
+				printf( "verify: raw file saved over itself differs\n" );
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// output of the extraction modes, buffers are kept between iterations
+struct BenchOutput {
+	MarchingCubes::Mesh		mesh;
+	MarchingCubes::MeshSoA	meshSoA;
+	MarchingCubes::CompactMesh	meshCompact;
+	MarchingCubes::ChunkedMesh	chunked;
+	MarchingCubes::LodMesh		lod;
+	vector<MarchingCubes::Mesh>	levels;
+
+	// chunks of the scene for fillInTrianglesBatch, kept between iterations like the meshes
+	vector< unique_ptr<VoxelField> >	batchFields;
+	vector<VoxelField*>					batchPtrs;
+	vector<MarchingCubes::Mesh>			batchMeshes;
+
+	// all chunks in one mesh, only for verification
+	vector<MarchingCubes::Vertex>		chunkVerts;
+	vector<MarchingCubes::TriangleI>	chunkTris;
+};
+
+// copies the scene into chunk fields of opt.batch cubes, neighbours share their border samples
+static void splitScene( VoxelField& field, BenchOutput& out, const BenchOptions& opt )
+{
+	int cubes[3] = { field.getSizeX()-1, field.getSizeY()-1, field.getSizeZ()-1 };
+	int num[3];
+	for( int a = 0; a < 3; a++ )
+		num[a] = max( (cubes[a] + opt.batch-1) / opt.batch, 1 );
+
+	size_t count = (size_t)num[0] * num[1] * num[2];
+	while( out.batchFields.size() < count )
+		out.batchFields.push_back( unique_ptr<VoxelField>( new VoxelField ) );
+	out.batchFields.resize( count );
+	out.batchPtrs.resize( count );
+	out.batchMeshes.resize( count );
+
+	int c = 0;
+	for( int cz = 0; cz < num[2]; cz++ )
+	for( int cy = 0; cy < num[1]; cy++ )
+	for( int cx = 0; cx < num[0]; cx++, c++ )
+	{
+		int lo[3] = { cx * opt.batch, cy * opt.batch, cz * opt.batch };
+		int size[3];
+		for( int a = 0; a < 3; a++ )
+			size[a] = min( opt.batch, max( cubes[a] - lo[a], 1 ) ) + 1;
+
+		// storage is reallocated by setSize, chunks keep their size from one iteration to the next
+		VoxelField& chunk = *out.batchFields[c];
+		if( chunk.getSizeX() != size[0] || chunk.getSizeY() != size[1] || chunk.getSizeZ() != size[2] ) {
+			chunk.setBrickIndex( opt.bricks );
+			chunk.setSize( size[0], size[1], size[2] );
+		}
+		for( int z = 0; z < size[2]; z++ )
+		for( int y = 0; y < size[1]; y++ )
+		for( int x = 0; x < size[0]; x++ ) {
+			float val;
+			field.getVal( min( lo[0] + x, cubes[0] ), min( lo[1] + y, cubes[1] ), min( lo[2] + z, cubes[2] ), &val );
+			chunk.setVal( x, y, z, val );
+		}
+		// ranges of a reused chunk would only grow
+		if( opt.bricks )
+			chunk.rebuildBrickIndex();
+		out.batchPtrs[c] = &chunk;
+	}
+}
+
+// extracted geometry, it lives in a mesh or in the stream sink
+struct BenchGeometry {
+	const MarchingCubes::Vertex*	verts;
+	int								vertexNum;
+	const MarchingCubes::TriangleI*	tris;
+	int								triNum;
+};
+
+// streaming consumer, it only counts the geometry unless it has to keep it for verification
+struct BenchSink {
+	bool								keep;
+	int									vertexNum;
+	int									triNum;
+	vector<MarchingCubes::Vertex>		verts;
+	vector<MarchingCubes::TriangleI>	tris;
+
+	void vertex( int, const MarchingCubes::Vector3F& pos, const MarchingCubes::Vector3F& norm ) {
+		vertexNum++;
+		if( keep ) {
+			MarchingCubes::Vertex vert;
+			vert.pos = pos;
+			vert.norm = norm;
+			verts.push_back( vert );
+		}
+	}
+	void triangle( const MarchingCubes::TriangleI& tri ) {
+		triNum++;
+		if( keep )
+			tris.push_back( tri );
+	}
+};
+
+// counts the geometry of all chunks, with 'keep' set it's also merged into one mesh
+template<class ChunkMesh>
+static BenchGeometry mergeChunks( const ChunkMesh& mesh, BenchOutput& out, bool keep )
+{
+	out.chunkVerts.clear();
+	out.chunkTris.clear();
+	BenchGeometry res = { NULL, 0, NULL, 0 };
+	for( int c = 0; c < mesh.getChunkNum(); c++ )
+	{
+		const MarchingCubes::Mesh& chunk = mesh.getChunk( c );
+		if( keep ) {
+			int base = (int)out.chunkVerts.size();
+			out.chunkVerts.insert( out.chunkVerts.end(), chunk.getVertices(), chunk.getVertices() + chunk.getVertexNum() );
+			for( int t = 0; t < chunk.getTriNum(); t++ ) {
+				MarchingCubes::TriangleI tri = chunk.getTriangles()[t];
+				for( int i = 0; i < 3; i++ )
+					tri[i] += base;
+				out.chunkTris.push_back( tri );
+			}
+		}
+		res.vertexNum += chunk.getVertexNum();
+		res.triNum += chunk.getTriNum();
+	}
+	res.verts = out.chunkVerts.data();
+	res.tris = out.chunkTris.data();
+	return res;
+}
+
+static BenchGeometry extract( MarchingCubes& march, VoxelField& field, BenchOutput& out, BenchSink& sink, const BenchOptions& opt )
+{
+	MarchingCubes::Mesh& mesh = out.mesh;
+	MarchingCubes::MeshSoA& meshSoA = out.meshSoA;
+
+	if( opt.soa )
+	{
+		march.fillInTrianglesIndexed( meshSoA );
+
+		// only verification needs it as Vertex array
+		if( sink.keep ) {
+			sink.verts.resize( meshSoA.getVertexNum() );
+			for( int v = 0; v < meshSoA.getVertexNum(); v++ ) {
+				sink.verts[v].pos = meshSoA.getPositions()[v];
+				sink.verts[v].norm = meshSoA.getNormals()[v];
+			}
+		}
+		BenchGeometry res = { sink.verts.data(), meshSoA.getVertexNum(), meshSoA.getTriangles(), meshSoA.getTriNum() };
+		return res;
+	}
+
+	// only counted, chunks are merged for verification
+	if( opt.edit )
+	{
+		march.updateChunkedMesh( out.chunked );
+		return mergeChunks( out.chunked, out, sink.keep );
+	}
+
+	if( opt.lod > 0.0f )
+	{
+		if( !out.lod.getChunkNum() )
+			march.initLodMesh( out.lod, 5 );
+
+		MarchingCubes::Vector3F eye;
+		eye.f[0] = 0.5f * (field.getSizeX()-1);
+		eye.f[1] = 0.5f * (field.getSizeY()-1);
+		eye.f[2] = 0.0f;
+		march.selectLods( out.lod, eye, opt.lod, 3 );
+		march.fillInTrianglesLod( out.lod );
+		return mergeChunks( out.lod, out, sink.keep );
+	}
+
+	// only counted, every chunk is verified on its own
+	if( opt.batch > 0 )
+	{
+		march.fillInTrianglesBatch( out.batchPtrs.data(), (int)out.batchPtrs.size(), out.batchMeshes.data(), opt.threads < 0 ? 1 : opt.threads );
+
+		BenchGeometry res = { NULL, 0, NULL, 0 };
+		for( size_t c = 0; c < out.batchMeshes.size(); c++ ) {
+			res.vertexNum += out.batchMeshes[c].getVertexNum();
+			res.triNum += out.batchMeshes[c].getTriNum();
+		}
+		return res;
+	}
+
+	// only counted, every level is verified on its own
+	if( opt.isoValues.size() > 1 )
+	{
+		out.levels.resize( opt.isoValues.size() );
+		march.fillInTrianglesLevels( opt.isoValues.data(), (int)opt.isoValues.size(), out.levels.data() );
+
+		BenchGeometry res = { NULL, 0, NULL, 0 };
+		for( size_t l = 0; l < out.levels.size(); l++ ) {
+			res.vertexNum += out.levels[l].getVertexNum();
+			res.triNum += out.levels[l].getTriNum();
+		}
+		return res;
+	}
+
+	// decoded only by verifyCompact
+	if( opt.compact )
+	{
+		march.fillInTrianglesCompact( out.meshCompact );
+
+		BenchGeometry res = { NULL, out.meshCompact.getVertexNum(), out.meshCompact.getTriangles(), out.meshCompact.getTriNum() };
+		return res;
+	}
+
+	if( opt.stream )
+	{
+		sink.vertexNum = sink.triNum = 0;
+		sink.verts.clear();
+		sink.tris.clear();
+		march.streamTrianglesIndexed( sink );
+
+		BenchGeometry res = { sink.verts.data(), sink.vertexNum, sink.tris.data(), sink.triNum };
+		return res;
+	}
+
+	if( opt.twoPass )
+	{
+		int vertexNum, triNum;
+		march.countTrianglesIndexed( vertexNum, triNum, opt.threads < 0 ? 1 : opt.threads );
+		march.fillInTrianglesIndexedCounted( mesh );
+	}
+	else if( opt.threads < 0 )
+		march.fillInTrianglesIndexed( mesh );
+	else
+		march.fillInTrianglesIndexedParallel( mesh, opt.threads );
+
+	BenchGeometry res = { mesh.getVertices(), mesh.getVertexNum(), mesh.getTriangles(), mesh.getTriNum() };
+	return res;
+}
+
+// triangle as 9 coordinates, rotated so the smallest vertex goes first, winding is kept
+struct BenchTriangle {
+	float	c[9];
+
+	bool operator< ( const BenchTriangle& t ) const {
+		return lexicographical_compare( c, c+9, t.c, t.c+9 );
+	}
+	bool operator== ( const BenchTriangle& t ) const {
+		return equal( c, c+9, t.c );
+	}
+};
+
+static void sortedTriangles( const BenchGeometry& mesh, vector<BenchTriangle>& res )
+{
+	const MarchingCubes::Vertex* verts = mesh.verts;
+	const MarchingCubes::TriangleI* tris = mesh.tris;
+
+	res.resize( mesh.triNum );
+	for( int t = 0; t < mesh.triNum; t++ )
+	{
+		const float* pos[3];
+		for( int i = 0; i < 3; i++ )
+			pos[i] = verts[ tris[t][i] ].pos.f;
+
+		int first = 0;
+		for( int i = 1; i < 3; i++ ) {
+			if( lexicographical_compare( pos[i], pos[i]+3, pos[first], pos[first]+3 ) )
+				first = i;
+		}
+		for( int i = 0; i < 3; i++ )
+			memcpy( res[t].c + 3*i, pos[ (first+i) % 3 ], 3*sizeof(float) );
+	}
+	sort( res.begin(), res.end() );
+}
+
+// checks that the mesh has the same triangles, vertex count and normals as the single threaded one
+//		with 'repeated' set the mesh may repeat vertices, like chunks do on their borders, but they need the same normals
+static bool verifyMesh( MarchingCubes& march, VoxelField& field, const BenchGeometry& mesh, bool repeated )
+{
+	MarchingCubes::Mesh refMesh;
+
+	MarchingCubes::CacheMode mode = march.getCacheMode();
+	bool bricks = field.hasBrickIndex();
+	MarchingCubes::ClassifyKernel kernel = MarchingCubes::getClassifyKernel();
+	march.setCacheMode( MarchingCubes::CACHE_FULL );
+	field.setBrickIndex( false );
+	MarchingCubes::setClassifyKernel( MarchingCubes::CLASSIFY_SCALAR );
+	march.fillInTrianglesIndexed( refMesh );
+	march.setCacheMode( mode );
+	field.setBrickIndex( bricks );
+	MarchingCubes::setClassifyKernel( kernel );
+
+	BenchGeometry ref = { refMesh.getVertices(), refMesh.getVertexNum(), refMesh.getTriangles(), refMesh.getTriNum() };
+	if( (!repeated && ref.vertexNum != mesh.vertexNum) || ref.triNum != mesh.triNum ) {
+		printf( "verify: %d verts %d tris, reference %d verts %d tris\n",
+				mesh.vertexNum, mesh.triNum, ref.vertexNum, ref.triNum );
+		return false;
+	}
+
+	vector<BenchTriangle> a, b;
+	sortedTriangles( mesh, a );
+	sortedTriangles( ref, b );
+	if( a != b ) {
+		printf( "verify: triangles differ from the reference\n" );
+		return false;
+	}
+
+	// vertices are matched by sorting both meshes by position, when the field is exactly 0
+	// at a corner a few vertices share one position, those can't be matched and are skipped
+	vector<BenchTriangle> va( mesh.vertexNum ), vb( ref.vertexNum );
+	for( int v = 0; v < mesh.vertexNum; v++ ) {
+		memcpy( va[v].c, mesh.verts[v].pos.f, 3*sizeof(float) );
+		memcpy( va[v].c+3, mesh.verts[v].norm.f, 3*sizeof(float) );
+	}
+	for( int v = 0; v < ref.vertexNum; v++ ) {
+		memcpy( vb[v].c, ref.verts[v].pos.f, 3*sizeof(float) );
+		memcpy( vb[v].c+3, ref.verts[v].norm.f, 3*sizeof(float) );
+	}
+	sort( va.begin(), va.end() );
+	sort( vb.begin(), vb.end() );
+
+	// repeated copies have to be exactly the same, then there's one of each left
+	//		vertices of zero area triangles have NaN normals, those are compared as zeros
+	if( repeated ) {
+		for( vector<BenchTriangle>* list : { &va, &vb } ) {
+			for( BenchTriangle& v : *list ) {
+				if( v.c[3] != v.c[3] )
+					v.c[3] = v.c[4] = v.c[5] = 0.0f;
+			}
+			sort( list->begin(), list->end() );
+		}
+		va.erase( unique( va.begin(), va.end() ), va.end() );
+		vb.erase( unique( vb.begin(), vb.end() ), vb.end() );
+		if( va.size() != vb.size() ) {
+			printf( "verify: %d different vertices, reference %d\n", (int)va.size(), (int)vb.size() );
+			return false;
+		}
+	}
+	int vertexNum = (int)va.size();
+
+	float maxDiff = 0.0f;
+	for( int v = 0; v < vertexNum; v++ )
+	{
+		float* pa = va[v].c;
+		float* pb = vb[v].c;
+		if( !equal( pa, pa+3, pb ) ) {
+			printf( "verify: vertex positions differ from the reference\n" );
+			return false;
+		}
+		bool samePrev = v > 0 && equal( pa, pa+3, va[v-1].c );
+		bool sameNext = v+1 < vertexNum && equal( pa, pa+3, va[v+1].c );
+		if( samePrev || sameNext )
+			continue;
+
+		MarchingCubes::Vector3F diff( pa[3] - pb[3], pa[4] - pb[4], pa[5] - pb[5] );
+		if( diff.isNotZero() )
+			maxDiff = max( maxDiff, diff.length() );
+	}
+	if( maxDiff > 1e-4f ) {
+		printf( "verify: normals differ from the reference by %g\n", maxDiff );
+		return false;
+	}
+	return true;
+}
+
+// checks that the mesh has the same triangles as the one of a fresh object and all its indices are valid
+static bool sameAsFresh( const MarchingCubes::Mesh& mesh, VoxelField& field, MarchingCubes::CacheMode mode )
+{
+	MarchingCubes fresh( field );
+	fresh.setCacheMode( mode );
+	MarchingCubes::Mesh refMesh;
+	fresh.fillInTrianglesIndexed( refMesh );
+
+	BenchGeometry geom = { mesh.getVertices(), mesh.getVertexNum(), mesh.getTriangles(), mesh.getTriNum() };
+	BenchGeometry ref = { refMesh.getVertices(), refMesh.getVertexNum(), refMesh.getTriangles(), refMesh.getTriNum() };
+	if( geom.vertexNum != ref.vertexNum || geom.triNum != ref.triNum )
+		return false;
+	for( int t = 0; t < geom.triNum; t++ )
+	for( int i = 0; i < 3; i++ ) {
+		if( geom.tris[t][i] < 0 || geom.tris[t][i] >= geom.vertexNum )
+			return false;
+	}
+
+	vector<BenchTriangle> a, b;
+	sortedTriangles( geom, a );
+	sortedTriangles( ref, b );
+	return a == b;
+}
+
+// one object fills a field and then a shallower one of an odd depth with the cache kept from the first fill,
+//		stamps of the deeper field must not look like the ones of the shallower one
+static bool verifyCacheReuse()
+{
+	static const MarchingCubes::CacheMode modes[2] = { MarchingCubes::CACHE_ROLLING, MarchingCubes::CACHE_FULL };
+	// full cache is kept only for the same power of 2 depth
+	static const int shallowZ[2] = { 9, 17 };
+
+	for( int m = 0; m < 2; m++ )
+	for( int s = 0; s < 2; s++ )
+	{
+		VoxelField field( 12, 11, 23 );
+		field.setPerlinNoise( 0 );
+
+		MarchingCubes march( field );
+		march.setCacheMode( modes[m] );
+		MarchingCubes::Mesh mesh;
+		march.fillInTrianglesIndexed( mesh );
+
+		field.setSize( 12, 11, shallowZ[s] );
+		field.setPerlinNoise( 1 );
+		march.fillInTrianglesIndexed( mesh );
+		if( !sameAsFresh( mesh, field, modes[m] ) ) {
+			printf( "verify: %s cache reused for a shallower field differs from a fresh object\n",
+					m == 0 ? "rolling" : "full" );
+			return false;
+		}
+	}
+	return true;
+}
+
+// workers of fillInTrianglesBatch are moved between fields of different depths, every mesh has to be
+//		the same as the one of a fresh object
+static bool verifyMixedBatch()
+{
+	const int fieldNum = 64;
+	vector<unique_ptr<VoxelField>> fields( fieldNum );
+	vector<VoxelField*> ptrs( fieldNum );
+	for( int i = 0; i < fieldNum; i++ ) {
+		fields[i].reset( new VoxelField( 12, 11, (i & 1) ? 9 : 23 ) );
+		fields[i]->setPerlinNoise( i );
+		ptrs[i] = fields[i].get();
+	}
+
+	VoxelField masterField( 2, 2, 2 );
+	MarchingCubes march( masterField );
+	vector<MarchingCubes::Mesh> meshes( fieldNum );
+	for( int threads : { 1, 4 } ) {
+		march.fillInTrianglesBatch( &ptrs[0], fieldNum, &meshes[0], threads );
+		for( int i = 0; i < fieldNum; i++ ) {
+			if( !sameAsFresh( meshes[i], *fields[i], march.getCacheMode() ) ) {
+				printf( "verify: field %d of a mixed size batch on %d threads differs from a fresh object\n", i, threads );
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// counts made at another isovalue mustn't be used for the fill, the mesh version counts again
+static bool verifyStaleCounts( MarchingCubes& march, int threads )
+{
+	float isoValue = march.getIsoValue();
+	int vertexNum, triNum;
+	march.countTrianglesIndexed( vertexNum, triNum, threads );
+	march.setIsoValue( isoValue + 0.25f );
+
+	vector<MarchingCubes::Vertex> verts( vertexNum + 1 );
+	vector<MarchingCubes::TriangleI> tris( triNum + 1 );
+	MarchingCubes::Mesh counted, ref;
+	bool stale = march.fillInTrianglesIndexedCounted( verts.data(), tris.data() ) == 0;
+	march.fillInTrianglesIndexedCounted( counted );
+	march.fillInTrianglesIndexed( ref );
+	march.setIsoValue( isoValue );
+
+	if( !stale ) {
+		printf( "verify: the counted fill used counts of another isovalue\n" );
+		return false;
+	}
+	if( counted.getTriNum() != ref.getTriNum() || counted.getVertexNum() != ref.getVertexNum() ) {
+		printf( "verify: the counted mesh has %d triangles after the isovalue changed, %d expected\n", counted.getTriNum(), ref.getTriNum() );
+		return false;
+	}
+	return true;
+}
+
+// the pruned sparse field has to give the same meshes as the whole field at every isovalue, normals included
+static bool verifyPruned( MarchingCubes& march, VoxelField& field, const BenchOptions& opt, int scene )
+{
+	VoxelField whole;
+	whole.setSize( field.getSizeX(), field.getSizeY(), field.getSizeZ() );
+	generateScene( whole, opt, scene, opt.iterations-1 );
+
+	vector<float> levels = opt.isoValues;
+	if( levels.empty() )
+		levels.push_back( 0.0f );
+	for( size_t l = 0; l < levels.size(); l++ )
+	{
+		MarchingCubes pruned( field );
+		MarchingCubes ref( whole );
+		MarchingCubes::Mesh mesh, refMesh;
+		pruned.setIsoValue( levels[l] );
+		pruned.setNormalMode( march.getNormalMode() );
+		ref.setIsoValue( levels[l] );
+		ref.setNormalMode( march.getNormalMode() );
+		pruned.fillInTrianglesIndexed( mesh );
+		ref.fillInTrianglesIndexed( refMesh );
+
+		bool same = mesh.getVertexNum() == refMesh.getVertexNum() && mesh.getTriNum() == refMesh.getTriNum() &&
+					memcmp( mesh.getVertices(), refMesh.getVertices(), mesh.getVertexNum() * sizeof(MarchingCubes::Vertex) ) == 0 &&
+					memcmp( mesh.getTriangles(), refMesh.getTriangles(), mesh.getTriNum() * sizeof(MarchingCubes::TriangleI) ) == 0;
+		if( !same ) {
+			printf( "verify: pruned sparse field differs from the whole one at isovalue %g\n", levels[l] );
+			return false;
+		}
+	}
+	return true;
+}
+
+// checks that the compact mesh decodes to the single threaded one within the error bounds of MarchingCubes.h
+//		vertices and triangles come in the same order, so they are compared by index
+static bool verifyCompact( MarchingCubes& march, const MarchingCubes::CompactMesh& mesh )
+{
+	MarchingCubes::Mesh refMesh;
+
+	MarchingCubes::CacheMode mode = march.getCacheMode();
+	march.setCacheMode( MarchingCubes::CACHE_FULL );
+	march.fillInTrianglesIndexed( refMesh );
+	march.setCacheMode( mode );
+
+	if( refMesh.getVertexNum() != mesh.getVertexNum() || refMesh.getTriNum() != mesh.getTriNum() ) {
+		printf( "verify: %d verts %d tris, reference %d verts %d tris\n",
+				mesh.getVertexNum(), mesh.getTriNum(), refMesh.getVertexNum(), refMesh.getTriNum() );
+		return false;
+	}
+	for( int t = 0; t < mesh.getTriNum(); t++ ) {
+		const MarchingCubes::TriangleI& a = mesh.getTriangles()[t];
+		const MarchingCubes::TriangleI& b = refMesh.getTriangles()[t];
+		if( a[0] != b[0] || a[1] != b[1] || a[2] != b[2] ) {
+			printf( "verify: triangles differ from the reference\n" );
+			return false;
+		}
+	}
+
+	float maxPos = 0.0f;
+	float maxAngle = 0.0f;
+	for( int v = 0; v < mesh.getVertexNum(); v++ )
+	{
+		const MarchingCubes::Vertex& ref = refMesh.getVertices()[v];
+		MarchingCubes::Vector3F pos = mesh.getPosition( v );
+		for( int i = 0; i < 3; i++ )
+			maxPos = max( maxPos, fabsf( pos.f[i] - ref.pos.f[i] ) );
+
+		// vertices with only zero area triangles have no normal
+		if( !(MarchingCubes::dotProduct( ref.norm, ref.norm ) > 0.5f) )
+			continue;
+		// acos is too coarse near 1 for such small angles
+		MarchingCubes::Vector3F norm = mesh.getNormal( v );
+		MarchingCubes::Vector3F refNorm = ref.norm;
+		float cross[3];
+		MarchingCubes::getCrossProduct( norm.f, refNorm.f, cross );
+		float sin = sqrtf( cross[0]*cross[0] + cross[1]*cross[1] + cross[2]*cross[2] );
+		float angle = atan2f( sin, MarchingCubes::dotProduct( norm, refNorm ) ) * 180.0f / 3.14159265f;
+		maxAngle = max( maxAngle, angle );
+	}
+
+	float posBound = 0.5f / mesh.getPositionScale();
+	printf( "verify: max position error %g (bound %g), max normal error %g deg\n", maxPos, posBound, maxAngle );
+	// a bit of slack for float rounding of the decoded position
+	if( maxPos > posBound * 1.01f || maxAngle > 0.005f ) {
+		printf( "verify: compact mesh is outside of the error bounds\n" );
+		return false;
+	}
+	return true;
+}
+
+// quantized position
+struct BenchWeldKey {
+	long long	c[3];
+
+	bool operator< ( const BenchWeldKey& k ) const {
+		return lexicographical_compare( c, c+3, k.c, k.c+3 );
+	}
+};
+
+// edges used by one triangle only, except edges on the faces of the field where the surface is cut off
+//		vertices are welded by position first, chunks repeat vertices on their borders
+//		chunkOpen counts the ones lying in a plane between chunks of chunkSize cubes
+static int countOpenEdges( VoxelField& field, const BenchGeometry& mesh, int chunkSize, int* chunkOpen )
+{
+	const float scale = 1024.0f;
+	int last[3] = { field.getSizeX()-1, field.getSizeY()-1, field.getSizeZ()-1 };
+
+	// vertex index -> welded index
+	vector< pair< BenchWeldKey, int > > keys( mesh.vertexNum );
+	for( int v = 0; v < mesh.vertexNum; v++ ) {
+		for( int a = 0; a < 3; a++ )
+			keys[v].first.c[a] = llrintf( mesh.verts[v].pos.f[a] * scale );
+		keys[v].second = v;
+	}
+	sort( keys.begin(), keys.end() );
+	vector<int> weld( mesh.vertexNum );
+	// first vertex of every welded one
+	vector<int> first;
+	for( int v = 0; v < mesh.vertexNum; v++ ) {
+		if( !v || keys[v-1].first < keys[v].first )
+			first.push_back( keys[v].second );
+		weld[ keys[v].second ] = (int)first.size() - 1;
+	}
+
+	vector< pair<int,int> > edges;
+	for( int t = 0; t < mesh.triNum; t++ )
+	{
+		int w[3];
+		for( int i = 0; i < 3; i++ )
+			w[i] = weld[ mesh.tris[t][i] ];
+		// collapsed by welding
+		if( w[0] == w[1] || w[1] == w[2] || w[2] == w[0] )
+			continue;
+		for( int i = 0; i < 3; i++ )
+			edges.push_back( make_pair( min( w[i], w[(i+1)%3] ), max( w[i], w[(i+1)%3] ) ) );
+	}
+	sort( edges.begin(), edges.end() );
+
+	int open = 0;
+	for( size_t e = 0; e < edges.size(); )
+	{
+		size_t next = e+1;
+		while( next < edges.size() && edges[next] == edges[e] )
+			next++;
+
+		if( next - e == 1 ) {
+			const float* a = mesh.verts[ first[ edges[e].first ] ].pos.f;
+			const float* b = mesh.verts[ first[ edges[e].second ] ].pos.f;
+			bool border = false;
+			for( int i = 0; i < 3; i++ )
+				border |= (a[i] == 0.0f && b[i] == 0.0f) || (a[i] == (float)last[i] && b[i] == (float)last[i]);
+			if( !border )
+				open++;
+
+			// in a plane between two chunks
+			bool chunk = false;
+			for( int i = 0; i < 3; i++ )
+				chunk |= a[i] == b[i] && a[i] == floorf( a[i] ) && (int)a[i] % chunkSize == 0;
+			if( !border && chunk )
+				(*chunkOpen)++;
+		}
+		e = next;
+	}
+	return open;
+}
+
+// checks indices and normals of the lod chunks and prints their cracks next to the ones of all chunks at lod 0
+//		the ones between chunks apart, stitching leaves only those of ambiguous coarse faces there
+//		a single mesh has open edges too, where the surface passes through ambiguous faces of the cubes
+static bool verifyLod( MarchingCubes& march, VoxelField& field, const MarchingCubes::LodMesh& lod, const BenchGeometry& mesh )
+{
+	for( int t = 0; t < mesh.triNum; t++ ) {
+		for( int i = 0; i < 3; i++ ) {
+			if( mesh.tris[t][i] < 0 || mesh.tris[t][i] >= mesh.vertexNum ) {
+				printf( "verify: triangle %d uses vertex %d of %d\n", t, mesh.tris[t][i], mesh.vertexNum );
+				return false;
+			}
+		}
+	}
+	for( int v = 0; v < mesh.vertexNum; v++ ) {
+		const MarchingCubes::Vector3F& n = mesh.verts[v].norm;
+		float len = n.f[0]*n.f[0] + n.f[1]*n.f[1] + n.f[2]*n.f[2];
+		// zero when all triangles of the vertex are degenerate
+		if( len != 0.0f && !(fabsf( len - 1.0f ) < 0.001f) ) {
+			printf( "verify: normal of vertex %d isn't a unit vector\n", v );
+			return false;
+		}
+	}
+
+	// stitching triangles lie in a face of their chunk, towards a coarser chunk or the next one of the same lod
+	int cubes[3] = { field.getSizeX()-1, field.getSizeY()-1, field.getSizeZ()-1 };
+	int chunkNum[3] = { lod.getChunkNumX(), lod.getChunkNumY(), lod.getChunkNumZ() };
+	int shift = lod.getChunkShift();
+	int c[3];
+	for( c[2] = 0; c[2] < chunkNum[2]; c[2]++ )
+	for( c[1] = 0; c[1] < chunkNum[1]; c[1]++ )
+	for( c[0] = 0; c[0] < chunkNum[0]; c[0]++ )
+	{
+		const MarchingCubes::Mesh& chunk = lod.getChunk( c[0], c[1], c[2] );
+		int chunkLod = min( max( lod.getLod( c[0], c[1], c[2] ), 0 ), shift );
+		for( int t = lod.getStitchStart( c[0], c[1], c[2] ); t < chunk.getTriNum(); t++ )
+		{
+			const MarchingCubes::TriangleI& tri = chunk.getTriangles()[t];
+			bool onFace = false;
+			for( int axis = 0; axis < 3 && !onFace; axis++ )
+			for( int side = 0; side < 2 && !onFace; side++ )
+			{
+				int n[3] = { c[0], c[1], c[2] };
+				n[axis] += side ? 1 : -1;
+				if( n[axis] < 0 || n[axis] >= chunkNum[axis] )
+					continue;
+				int nlod = min( max( lod.getLod( n[0], n[1], n[2] ), 0 ), shift );
+				if( nlod < chunkLod || (nlod == chunkLod && !side) )
+					continue;
+
+				float plane = (float)min( (c[axis] + side) << shift, cubes[axis] );
+				onFace = true;
+				for( int i = 0; i < 3; i++ )
+					onFace &= chunk.getVertices()[ tri[i] ].pos.f[axis] == plane;
+			}
+			if( !onFace ) {
+				printf( "verify: stitching triangle %d of chunk (%d,%d,%d) isn't in a face towards a coarser chunk\n", t, c[0], c[1], c[2] );
+				return false;
+			}
+		}
+	}
+
+	BenchOutput ref;
+	MarchingCubes::LodMesh& lod0 = ref.lod;
+	march.initLodMesh( lod0, 5 );
+	march.fillInTrianglesLod( lod0 );
+	BenchGeometry refMesh = mergeChunks( lod0, ref, true );
+
+	int chunkOpen = 0, refChunkOpen = 0;
+	int open = countOpenEdges( field, mesh, 1 << 5, &chunkOpen );
+	int refOpen = countOpenEdges( field, refMesh, 1 << 5, &refChunkOpen );
+	printf( "verify: %d open edges (%d between chunks), %d with all chunks at lod 0 (%d)\n", open, chunkOpen, refOpen, refChunkOpen );
+	// the case table leaves some open edges at any lod, stitching mustn't add to those between chunks
+	if( chunkOpen > refChunkOpen ) {
+		printf( "verify: chunks of different lods leave more open edges between them than at lod 0\n" );
+		return false;
+	}
+	return true;
+}
+
+static bool runScene( MarchingCubes& march, VoxelField& field, const BenchOptions& opt, int scene, double initMs )
+{
+	if( scene == SCENE_SPHERES || scene == SCENE_PERLIN )
+		field.setSize( opt.sizeX, opt.sizeY, opt.sizeZ );
+
+	// kept by following setSize calls
+	field.setBrickIndex( opt.bricks );
+
+	// warm-up run, it also grows the mesh to fit the scene
+	BenchOutput out;
+	BenchSink sink;
+	sink.keep = false;
+	generateScene( field, opt, scene, 0 );
+	if( opt.raw && !openRawScene( field, opt ) )
+		return false;
+	if( opt.batch > 0 )
+		splitScene( field, out, opt );
+	extract( march, field, out, sink, opt );
+
+	double fieldMs = 0.0;
+	double extractMs = 0.0;
+	double bestExtractMs = 0.0;
+	long long cells = 0;
+	long long tris = 0;
+	long long verts = 0;
+
+	for( int i = 0; i < opt.iterations; i++ )
+	{
+		BenchClock::time_point start = BenchClock::now();
+		if( opt.edit )
+			editScene( field, i );
+		else if( opt.raw )
+			field.openRaw( opt.raw );
+		else
+			generateScene( field, opt, scene, i );
+		if( opt.batch > 0 )
+			splitScene( field, out, opt );
+		fieldMs += msSince( start );
+
+		start = BenchClock::now();
+		BenchGeometry res = extract( march, field, out, sink, opt );
+		double ms = msSince( start );
+
+		extractMs += ms;
+		if( i == 0 || ms < bestExtractMs )
+			bestExtractMs = ms;
+
+		cells += (long long)(field.getSizeX()-1) * (field.getSizeY()-1) * (field.getSizeZ()-1);
+		tris += res.triNum;
+		verts += res.vertexNum;
+	}
+
+	char size[32];
+	sprintf( size, "%dx%dx%d", field.getSizeX(), field.getSizeY(), field.getSizeZ() );
+
+	double sec = extractMs / 1000.0;
+	printf( "%-10s %-14s %9.3f %10.3f %11.3f %11.3f %12.4g %12.4g %12.4g %10lld %10lld\n",
+			sceneNames[scene], size,
+			initMs,
+			fieldMs / opt.iterations,
+			extractMs / opt.iterations,
+			bestExtractMs,
+			sec > 0.0 ? cells / sec : 0.0,
+			sec > 0.0 ? tris / sec : 0.0,
+			sec > 0.0 ? verts / sec : 0.0,
+			tris / opt.iterations,
+			verts / opt.iterations );
+
+	// counted since the field was allocated, warm-up run included
+	if( field.getLayout() == VoxelField::LAYOUT_PAGED ) {
+		printf( "%-10s %lld bricks read, %lld written\n", "", field.getPageLoads(), field.getPageWrites() );
+		// the samples extracted may be stale then
+		if( field.getPageError() ) {
+			printf( "%s: bricks couldn't be written to the page file\n", sceneNames[scene] );
+			return false;
+		}
+	}
+	if( field.getLayout() == VoxelField::LAYOUT_SPARSE )
+		printf( "%-10s %d of %d bricks allocated, %.1f MB\n", "", field.getSparseBrickCount(), field.getStoredBrickCount(),
+				field.getSparseBrickCount() * VoxelField::BRICK_SIZE * VoxelField::BRICK_SIZE * VoxelField::BRICK_SIZE * sizeof(float) / 1048576.0 );
+
+	// the sink doesn't keep the geometry while it's measured
+	sink.keep = true;
+	bool verified = true;
+	if( opt.verify ) {
+		BenchGeometry res = extract( march, field, out, sink, opt );
+		if( opt.batch > 0 ) {
+			// every chunk against its own object, the way it would be generated without the batch
+			for( size_t c = 0; c < out.batchMeshes.size() && verified; c++ ) {
+				const MarchingCubes::Mesh& chunk = out.batchMeshes[c];
+				BenchGeometry geom = { chunk.getVertices(), chunk.getVertexNum(), chunk.getTriangles(), chunk.getTriNum() };
+				MarchingCubes chunkMarch( *out.batchPtrs[c] );
+				chunkMarch.setIsoValue( march.getIsoValue() );
+				chunkMarch.setNormalMode( march.getNormalMode() );
+				verified = verifyMesh( chunkMarch, *out.batchPtrs[c], geom, false );
+			}
+		}
+		else if( opt.isoValues.size() > 1 ) {
+			// the reference is generated at the isovalue of each level
+			for( size_t l = 0; l < out.levels.size() && verified; l++ ) {
+				const MarchingCubes::Mesh& level = out.levels[l];
+				BenchGeometry geom = { level.getVertices(), level.getVertexNum(), level.getTriangles(), level.getTriNum() };
+				march.setIsoValue( opt.isoValues[l] );
+				verified = verifyMesh( march, field, geom, false );
+			}
+			march.setIsoValue( 0.0f );
+		}
+		else if( opt.compact )
+			verified = verifyCompact( march, out.meshCompact );
+		else if( opt.lod > 0.0f )
+			verified = verifyLod( march, field, out.lod, res );
+		else
+			verified = verifyMesh( march, field, res, opt.edit );
+	}
+	// edits and raw files aren't generated again for the whole field
+	if( verified && opt.verify && field.getLayout() == VoxelField::LAYOUT_SPARSE && !opt.edit && !opt.raw )
+		verified = verifyPruned( march, field, opt, scene );
+	if( verified && opt.verify && opt.twoPass )
+		verified = verifyStaleCounts( march, opt.threads < 0 ? 1 : opt.threads );
+	if( !verified ) {
+		printf( "%s: verification FAILED\n", sceneNames[scene] );
+		return false;
+	}
+	return true;
+}
+
+static void printUsage( const char* name )
+{
+	printf( "usage: %s [-s N|X,Y,Z] [-i iterations] [-c spheres|perlin|ambiguous|zeroslice|all] [-p phase] [-t threads] [-2] [-S] [-a] [-q] [-T tile] [-l linear|bricked|paged|sparse] [-P MB] [-R file] [-e] [-L dist] [-I iso[,iso...]] [-B N] [-m full|rolling] [-b] [-k scalar|sse4|avx2|auto] [-v]\n", name );
+}
+
+static bool parseSize( const char* str, BenchOptions& opt )
+{
+	int x, y, z;
+	int n = sscanf( str, "%d,%d,%d", &x, &y, &z );
+	if( n == 1 )
+		y = z = x;
+	else if( n != 3 )
+		return false;
+	if( x < 2 || y < 2 || z < 2 )
+		return false;
+
+	opt.sizeX = x;
+	opt.sizeY = y;
+	opt.sizeZ = z;
+	return true;
+}
+
+static bool parseIsoValues( const char* str, BenchOptions& opt )
+{
+	opt.isoValues.clear();
+	for( ;; ) {
+		char* end;
+		float val = strtof( str, &end );
+		if( end == str )
+			return false;
+		opt.isoValues.push_back( val );
+		if( *end == 0 )
+			return true;
+		if( *end != ',' )
+			return false;
+		str = end + 1;
+	}
+}
+
+static bool parseScene( const char* str, BenchOptions& opt )
+{
+	if( !strcmp( str, "all" ) ) {
+		opt.scene = -1;
+		return true;
+	}
+	for( int s = 0; s < SCENE_COUNT; s++ ) {
+		if( !strcmp( str, sceneNames[s] ) ) {
+			opt.scene = s;
+			return true;
+		}
+	}
+	return false;
+}
+
+static const char* kernelNames[] = { "auto", "scalar", "sse4", "avx2" };
+
+static const char* layoutNames[] = { "linear", "bricked", "paged", "sparse" };
+
+static bool parseKernel( const char* str, BenchOptions& opt )
+{
+	for( int k = 0; k < 4; k++ ) {
+		if( !strcmp( str, kernelNames[k] ) ) {
+			opt.kernel = (MarchingCubes::ClassifyKernel)k;
+			return true;
+		}
+	}
+	return false;
+}
+
+int main( int argc, char** argv )
+{
+	BenchOptions opt;
+	opt.sizeX = opt.sizeY = opt.sizeZ = 64;
+	opt.iterations = 5;
+	opt.scene = -1;
+	opt.phase = 23.85f;
+	opt.threads = -1;
+	opt.twoPass = false;
+	opt.stream = false;
+	opt.soa = false;
+	opt.compact = false;
+	opt.edit = false;
+	opt.verify = false;
+	opt.cacheMode = MarchingCubes::CACHE_ROLLING;
+	opt.normalMode = MarchingCubes::NORMAL_TRIANGLES;
+	opt.bricks = false;
+	opt.kernel = MarchingCubes::CLASSIFY_AUTO;
+	opt.tile = 0;
+	opt.layout = VoxelField::LAYOUT_LINEAR;
+	opt.pageBudget = 64;
+	opt.raw = NULL;
+	opt.lod = 0.0f;
+	opt.batch = 0;
+
+	for( int a = 1; a < argc; a++ )
+	{
+		const char* arg = argv[a];
+		const char* val = (a+1 < argc) ? argv[a+1] : NULL;
+		bool ok = false;
+
+		if( !strcmp( arg, "-h" ) || !strcmp( arg, "--help" ) ) {
+			printUsage( argv[0] );
+			return 0;
+		}
+		else if( !strcmp( arg, "-v" ) || !strcmp( arg, "--verify" ) ) {
+			opt.verify = true;
+			continue;
+		}
+		else if( !strcmp( arg, "-2" ) || !strcmp( arg, "--two-pass" ) ) {
+			opt.twoPass = true;
+			continue;
+		}
+		else if( !strcmp( arg, "-S" ) || !strcmp( arg, "--stream" ) ) {
+			opt.stream = true;
+			continue;
+		}
+		else if( !strcmp( arg, "-a" ) || !strcmp( arg, "--soa" ) ) {
+			opt.soa = true;
+			continue;
+		}
+		else if( !strcmp( arg, "-q" ) || !strcmp( arg, "--compact" ) ) {
+			opt.compact = true;
+			continue;
+		}
+		else if( !strcmp( arg, "-e" ) || !strcmp( arg, "--edit" ) ) {
+			opt.edit = true;
+			continue;
+		}
+		else if( !strcmp( arg, "-b" ) || !strcmp( arg, "--bricks" ) ) {
+			opt.bricks = true;
+			continue;
+		}
+		else if( val && (!strcmp( arg, "-s" ) || !strcmp( arg, "--size" )) )
+			ok = parseSize( val, opt );
+		else if( val && (!strcmp( arg, "-i" ) || !strcmp( arg, "--iterations" )) )
+			ok = (opt.iterations = atoi( val )) > 0;
+		else if( val && (!strcmp( arg, "-c" ) || !strcmp( arg, "--scene" )) )
+			ok = parseScene( val, opt );
+		else if( val && (!strcmp( arg, "-p" ) || !strcmp( arg, "--phase" )) ) {
+			opt.phase = (float)atof( val );
+			ok = true;
+		}
+		else if( val && (!strcmp( arg, "-t" ) || !strcmp( arg, "--threads" )) )
+			ok = (opt.threads = atoi( val )) >= 0;
+		else if( val && (!strcmp( arg, "-l" ) || !strcmp( arg, "--layout" )) ) {
+			ok = false;
+			for( int l = 0; l < 4; l++ ) {
+				if( !strcmp( val, layoutNames[l] ) ) {
+					opt.layout = (VoxelField::Layout)l;
+					ok = true;
+				}
+			}
+		}
+		else if( val && (!strcmp( arg, "-P" ) || !strcmp( arg, "--page-budget" )) )
+			ok = (opt.pageBudget = atoi( val )) > 0;
+		else if( val && (!strcmp( arg, "-R" ) || !strcmp( arg, "--raw" )) ) {
+			opt.raw = val;
+			ok = true;
+		}
+		else if( val && (!strcmp( arg, "-L" ) || !strcmp( arg, "--lod" )) )
+			ok = (opt.lod = (float)atof( val )) > 0.0f;
+		else if( val && (!strcmp( arg, "-B" ) || !strcmp( arg, "--batch" )) )
+			ok = (opt.batch = atoi( val )) > 0;
+		else if( val && (!strcmp( arg, "-I" ) || !strcmp( arg, "--iso" )) )
+			ok = parseIsoValues( val, opt );
+		else if( val && (!strcmp( arg, "-T" ) || !strcmp( arg, "--tiled" )) )
+			ok = (opt.tile = atoi( val )) > 0;
+		else if( val && (!strcmp( arg, "-k" ) || !strcmp( arg, "--kernel" )) )
+			ok = parseKernel( val, opt );
+		else if( val && (!strcmp( arg, "-m" ) || !strcmp( arg, "--cache" )) ) {
+			ok = !strcmp( val, "full" ) || !strcmp( val, "rolling" );
+			opt.cacheMode = !strcmp( val, "full" ) ? MarchingCubes::CACHE_FULL : MarchingCubes::CACHE_ROLLING;
+		}
+		else if( val && (!strcmp( arg, "-n" ) || !strcmp( arg, "--normals" )) ) {
+			ok = !strcmp( val, "triangles" ) || !strcmp( val, "gradient" );
+			opt.normalMode = !strcmp( val, "gradient" ) ? MarchingCubes::NORMAL_GRADIENT : MarchingCubes::NORMAL_TRIANGLES;
+		}
+
+		if( !ok ) {
+			fprintf( stderr, "invalid argument: %s %s\n", arg, val ? val : "" );
+			printUsage( argv[0] );
+			return 1;
+		}
+		a++;
+	}
+
+	VoxelField		field;
+	if( opt.layout == VoxelField::LAYOUT_PAGED )
+		field.setPaging( NULL, (size_t)opt.pageBudget << 20 );
+	field.setLayout( opt.layout );
+	MarchingCubes*	march = new MarchingCubes( field );
+
+	BenchClock::time_point start = BenchClock::now();
+	march->init();
+	double initMs = msSince( start );
+
+	march->setCacheMode( opt.cacheMode );
+	march->setNormalMode( opt.normalMode );
+	if( opt.isoValues.size() == 1 )
+		march->setIsoValue( opt.isoValues[0] );
+	if( opt.tile > 0 )
+		march->setTraversalMode( MarchingCubes::TRAVERSAL_TILED, opt.tile );
+
+	if( !MarchingCubes::setClassifyKernel( opt.kernel ) ) {
+		fprintf( stderr, "%s kernel is not supported by this CPU\n", kernelNames[opt.kernel] );
+		delete march;
+		return 1;
+	}
+	printf( "classification kernel: %s\n", kernelNames[ MarchingCubes::getClassifyKernel() ] );
+
+	if( opt.verify && !march->checkTable() ) {
+		printf( "verify: compile time triangle table differs from the runtime one\n" );
+		delete march;
+		return 2;
+	}
+	if( opt.verify && (!verifyMixedBatch() || !verifyCacheReuse()) ) {
+		delete march;
+		return 2;
+	}
+
+	printf( "%-10s %-14s %9s %10s %11s %11s %12s %12s %12s %10s %10s\n",
+			"scene", "size", "init ms", "field ms", "extract ms", "best ms",
+			"cells/s", "tris/s", "verts/s", "tris", "verts" );
+
+	bool ok = true;
+	for( int s = 0; s < SCENE_COUNT; s++ ) {
+		if( opt.scene < 0 || opt.scene == s )
+			ok &= runScene( *march, field, opt, s, initMs );
+	}
+
+	delete march;
+	return ok ? 0 : 2;
+}
@@ -6,10 +6,11 @@
 
     Defines basic data structures and algorithms used to compute geometry
 
-    During initialization it analyzes all 256 possible cases and stores the result in a table:
+    All 256 possible cases are analyzed by the compiler into one read only CaseTable, every object
+    uses it from its creation, so an object is only the state of one generation - one per thread
+    can generate separate fields at the same time:
 
-        MarchingCubes mc;
-        mc.init();
+        MarchingCubes mc( field );
 
     Then you need to set corner values of the cube you want to generate:
 
@@ -33,6 +34,7 @@ TODO:	fix it
 
 #include "VoxelField.h"
 #include <math.h>
+#include <vector>
 
 #define CAP_TRI_OFFSET 16
 
@@ -50,23 +52,15 @@ public:
 
         float f[3];
 
-    	Vector3F( float x, float y, float z ) {
-			f[0] = x;
-			f[1] = y;
-			f[2] = z;
+    	constexpr Vector3F( float x, float y, float z ) : f{ x, y, z } {
     	}
-    	Vector3F() {
-			Vector3F( 0.0f, 0.0f, 0.0f );
+    	constexpr Vector3F() : f{ 0.0f, 0.0f, 0.0f } {
 		}
-        Vector3F& operator+ (Vector3F& v1)
+        constexpr Vector3F operator+ (const Vector3F& v1) const
         {
-			Vector3F res;
-            res.f[0] = f[0] + v1.f[0];
-            res.f[1] = f[1] + v1.f[1];
-            res.f[2] = f[2] + v1.f[2];
-            return res;
+            return Vector3F( f[0] + v1.f[0], f[1] + v1.f[1], f[2] + v1.f[2] );
         };
-        Vector3F& operator+= (const Vector3F& v1)
+        constexpr Vector3F& operator+= (const Vector3F& v1)
         {
             f[0] += v1.f[0];
             f[1] += v1.f[1];
@@ -74,14 +68,10 @@ public:
 
             return *this;
         }
-        Vector3F operator- (const Vector3F& v1) const {
-            Vector3F res;
-            res.f[0] = f[0] - v1.f[0];
-            res.f[1] = f[1] - v1.f[1];
-            res.f[2] = f[2] - v1.f[2];
-            return res;
+        constexpr Vector3F operator- (const Vector3F& v1) const {
+            return Vector3F( f[0] - v1.f[0], f[1] - v1.f[1], f[2] - v1.f[2] );
         };
-        Vector3F& operator-= (const Vector3F& v1)
+        constexpr Vector3F& operator-= (const Vector3F& v1)
         {
             f[0] -= v1.f[0];
             f[1] -= v1.f[1];
@@ -114,7 +104,6 @@ public:
     struct Vertex {
         Vector3F    pos;
         Vector3F    norm;
-        int			used;	// Debug variable, TODO: remove
     };
 
     // Triangle represented as 3 vector positions
@@ -125,30 +114,361 @@ public:
     // Triangle represented by 3 vector indices - will be needed for vertex buffers
     struct  TriangleI {
         int i[3];
-        int& operator[] (int index) {
+        constexpr int& operator[] (int index) {
+            return i[index];
+        };
+        constexpr const int& operator[] (int index) const {
             return i[index];
         };
     };
 
+    // Indexed mesh filled by fillInTrianglesIndexed, it owns its buffers and grows them when needed
+    //	buffers are never shrunk or cleared, so a mesh reused every frame stops allocating after a few frames
+    //	it can be moved, but not copied - copying the whole geometry by accident would be expensive
+    class Mesh {
+	public:
+		Mesh() : vertexNum(0), triNum(0) {
+		}
+		Mesh( Mesh&& ) = default;
+		Mesh& operator= ( Mesh&& ) = default;
+		Mesh( const Mesh& ) = delete;
+		Mesh& operator= ( const Mesh& ) = delete;
+
+		int					getVertexNum() const	{ return vertexNum; }
+		int					getTriNum() const		{ return triNum; }
+		Vertex*				getVertices()			{ return vert.data(); }
+		const Vertex*		getVertices() const		{ return vert.data(); }
+		TriangleI*			getTriangles()			{ return tris.data(); }
+		const TriangleI*	getTriangles() const	{ return tris.data(); }
+
+		// allocates buffers up front, if the size of the geometry is known
+		void	reserve( int maxVert, int maxTris ) {
+			if( (int)vert.size() < maxVert )
+				vert.resize( maxVert );
+			if( (int)tris.size() < maxTris )
+				tris.resize( maxTris );
+		}
+		// removes the geometry, buffers are kept
+		void	clear() {
+			vertexNum = triNum = 0;
+		}
+		// removes the geometry and frees buffers
+		void	release() {
+			clear();
+			vector<Vertex>().swap( vert );
+			vector<TriangleI>().swap( tris );
+		}
+
+	private:
+		friend class MarchingCubes;
+
+		vector<Vertex>		vert;
+		vector<TriangleI>	tris;
+		int					vertexNum;
+		int					triNum;
+    };
+
+    // The same as Mesh, but positions and normals are stored in two separate arrays
+    //	they can be uploaded as two vertex buffers, or normals can be processed without touching positions
+    class MeshSoA {
+	public:
+		MeshSoA() : vertexNum(0), triNum(0) {
+		}
+		MeshSoA( MeshSoA&& ) = default;
+		MeshSoA& operator= ( MeshSoA&& ) = default;
+		MeshSoA( const MeshSoA& ) = delete;
+		MeshSoA& operator= ( const MeshSoA& ) = delete;
+
+		int					getVertexNum() const	{ return vertexNum; }
+		int					getTriNum() const		{ return triNum; }
+		Vector3F*			getPositions()			{ return pos.data(); }
+		const Vector3F*		getPositions() const	{ return pos.data(); }
+		Vector3F*			getNormals()			{ return norm.data(); }
+		const Vector3F*		getNormals() const		{ return norm.data(); }
+		TriangleI*			getTriangles()			{ return tris.data(); }
+		const TriangleI*	getTriangles() const	{ return tris.data(); }
+
+		// allocates buffers up front, if the size of the geometry is known
+		void	reserve( int maxVert, int maxTris ) {
+			if( (int)pos.size() < maxVert ) {
+				pos.resize( maxVert );
+				norm.resize( maxVert );
+			}
+			if( (int)tris.size() < maxTris )
+				tris.resize( maxTris );
+		}
+		// removes the geometry, buffers are kept
+		void	clear() {
+			vertexNum = triNum = 0;
+		}
+		// removes the geometry and frees buffers
+		void	release() {
+			clear();
+			vector<Vector3F>().swap( pos );
+			vector<Vector3F>().swap( norm );
+			vector<TriangleI>().swap( tris );
+		}
+
+	private:
+		friend class MarchingCubes;
+
+		vector<Vector3F>	pos;
+		vector<Vector3F>	norm;
+		vector<TriangleI>	tris;
+		int					vertexNum;
+		int					triNum;
+    };
+
+    // Field geometry split into chunks of VoxelField::BRICK_SIZE^3 cubes, kept up to date by updateChunkedMesh
+    //	every chunk is a separate Mesh with positions in field coordinates, so one edit re-uploads only a few of them
+    //	vertices on chunk borders are repeated in both chunks, with the same normal as in the single mesh
+    class ChunkedMesh {
+	public:
+		ChunkedMesh() : chunkNumX(0), chunkNumY(0), chunkNumZ(0) {
+		}
+		ChunkedMesh( ChunkedMesh&& ) = default;
+		ChunkedMesh& operator= ( ChunkedMesh&& ) = default;
+		ChunkedMesh( const ChunkedMesh& ) = delete;
+		ChunkedMesh& operator= ( const ChunkedMesh& ) = delete;
+
+		int				getChunkNumX() const	{ return chunkNumX; }
+		int				getChunkNumY() const	{ return chunkNumY; }
+		int				getChunkNumZ() const	{ return chunkNumZ; }
+		int				getChunkNum() const		{ return (int)chunks.size(); }
+		const Mesh&		getChunk( int index ) const	{ return chunks[index]; }
+		const Mesh&		getChunk( int cx, int cy, int cz ) const {
+			return chunks[ (cz*chunkNumY + cy)*chunkNumX + cx ];
+		}
+
+		// indices of chunks generated by the last updateChunkedMesh
+		const vector<int>&	getUpdatedChunks() const	{ return updated; }
+
+		// removes all chunks, the next update generates the whole field
+		void	release() {
+			vector<Mesh>().swap( chunks );
+			vector<int>().swap( updated );
+			chunkNumX = chunkNumY = chunkNumZ = 0;
+		}
+
+	private:
+		friend class MarchingCubes;
+
+		vector<Mesh>	chunks;
+		vector<int>		updated;
+		int				chunkNumX;
+		int				chunkNumY;
+		int				chunkNumZ;
+    };
+
+    // Field geometry split into chunks of 2^chunkShift cubes, each one generated at its own level of detail by fillInTrianglesLod
+    //	a chunk at lod k takes every 2^k-th sample of the field, so it has 8^k times fewer cubes
+    //	positions are in field coordinates, chunks next to coarser ones are stitched to them, see MarchingCubesLod.cpp
+    class LodMesh {
+	public:
+		LodMesh() : chunkShift(5), chunkNumX(0), chunkNumY(0), chunkNumZ(0) {
+		}
+		LodMesh( LodMesh&& ) = default;
+		LodMesh& operator= ( LodMesh&& ) = default;
+		LodMesh( const LodMesh& ) = delete;
+		LodMesh& operator= ( const LodMesh& ) = delete;
+
+		int				getChunkShift() const	{ return chunkShift; }
+		int				getChunkNumX() const	{ return chunkNumX; }
+		int				getChunkNumY() const	{ return chunkNumY; }
+		int				getChunkNumZ() const	{ return chunkNumZ; }
+		int				getChunkNum() const		{ return (int)chunks.size(); }
+		const Mesh&		getChunk( int index ) const	{ return chunks[index]; }
+		const Mesh&		getChunk( int cx, int cy, int cz ) const {
+			return chunks[ (cz*chunkNumY + cy)*chunkNumX + cx ];
+		}
+
+		// lod of the chunk, used by the next fillInTrianglesLod, lods above chunkShift are clamped
+		int		getLod( int cx, int cy, int cz ) const {
+			return lods[ (cz*chunkNumY + cy)*chunkNumX + cx ];
+		}
+		void	setLod( int cx, int cy, int cz, int lod ) {
+			lods[ (cz*chunkNumY + cy)*chunkNumX + cx ] = lod;
+		}
+		// first triangle of the chunk closing gaps on its faces towards coarser chunks and on its +axis faces
+		//		towards chunks of the same lod, the ones before are its own
+		int		getStitchStart( int cx, int cy, int cz ) const {
+			return stitchStart[ (cz*chunkNumY + cy)*chunkNumX + cx ];
+		}
+
+		// removes all chunks, the next fill splits the field again with all lods set to 0
+		void	release() {
+			vector<Mesh>().swap( chunks );
+			vector<int>().swap( lods );
+			vector<int>().swap( stitchStart );
+			chunkNumX = chunkNumY = chunkNumZ = 0;
+		}
+
+	private:
+		friend class MarchingCubes;
+
+		vector<Mesh>	chunks;
+		vector<int>		lods;
+		vector<int>		stitchStart;
+		int				chunkShift;
+		int				chunkNumX;
+		int				chunkNumY;
+		int				chunkNumZ;
+    };
+
+    // Quantized vertex, 10 bytes instead of 24 bytes of Vertex
+    //	pos - fixed point grid coordinates, the scale is stored in CompactMesh, see encodePosition
+    //	norm - octahedral encoding of the unit normal as 2 signed 16 bit values, see encodeNormal
+    struct CompactVertex {
+		unsigned short	pos[3];
+		short			norm[2];
+    };
+
+    // Indexed mesh of compact vertices filled by fillInTrianglesCompact
+    //	vertices are quantized when their normals are final, so a full size float mesh never exists
+    class CompactMesh {
+	public:
+		CompactMesh() : posScale(1.0f) {
+		}
+		CompactMesh( CompactMesh&& ) = default;
+		CompactMesh& operator= ( CompactMesh&& ) = default;
+		CompactMesh( const CompactMesh& ) = delete;
+		CompactMesh& operator= ( const CompactMesh& ) = delete;
+
+		int						getVertexNum() const	{ return (int)vert.size(); }
+		int						getTriNum() const		{ return (int)tris.size(); }
+		const CompactVertex*	getVertices() const		{ return vert.data(); }
+		const TriangleI*		getTriangles() const	{ return tris.data(); }
+
+		// quantized position = grid position * scale, it's the same for all 3 axes
+		float					getPositionScale() const	{ return posScale; }
+
+		// decoded position in grid units and unit normal of vertex 'index'
+		Vector3F	getPosition( int index ) const {
+			return decodePosition( vert[index], posScale );
+		}
+		Vector3F	getNormal( int index ) const {
+			return decodeNormal( vert[index] );
+		}
+
+		// removes the geometry, buffers are kept
+		void	clear() {
+			vert.clear();
+			tris.clear();
+		}
+		// removes the geometry and frees buffers
+		void	release() {
+			vector<CompactVertex>().swap( vert );
+			vector<TriangleI>().swap( tris );
+		}
+
+	private:
+		friend class MarchingCubes;
+
+		vector<CompactVertex>	vert;
+		vector<TriangleI>		tris;
+		float					posScale;
+    };
+
+    // Compact vertex encoding
+    //	positions are stored as round( pos * scale ), getPositionScale gives scale = 65535 / (largest field size - 1),
+    //		so the error is 0.5 / scale per axis plus float rounding - 0.001 of a cube for a 128^3 field, 0.004 for 512^3
+    //	normals are projected on the octahedron |x|+|y|+|z| = 1, its lower half folded over the upper one,
+    //		and the 2D result stored as snorm16, the angle between the encoded and decoded normal is below 0.005 degree
+    static float		getPositionScale( int fieldSize );
+    static void			encodePosition( const Vector3F& pos, float scale, CompactVertex& v );
+    static Vector3F		decodePosition( const CompactVertex& v, float scale );
+    static void			encodeNormal( const Vector3F& norm, CompactVertex& v );
+    static Vector3F		decodeNormal( const CompactVertex& v );
+
+    // How much of the field is covered by the vertex cache
+    enum CacheMode {
+		CACHE_FULL,			// all planes of the field
+		CACHE_ROLLING		// only bottom and top plane of the current cube layer, memory is O(x*y)
+    };
+
+    // Source of vertex normals
+    enum NormalMode {
+		NORMAL_TRIANGLES,	// sum of normals of triangles using the vertex, normalised after the fill
+		NORMAL_GRADIENT		// central differences of the field at both ends of the edge, interpolated like the position
+							//	computed once per vertex, a vertex in a flat region of the field gets a zero normal
+    };
+
+    // Order of cubes inside one z layer, layers always go one after another along z like the field is stored
+    enum TraversalMode {
+		TRAVERSAL_ROWS,		// whole x rows, the storage order of the field
+		TRAVERSAL_TILED		// square tiles of short x rows, tiles in Morton order
+							//	rows of a linear field are already read in order, so it's slower there
+							//	- short runs are classified with less SIMD work per call
+    };
+
+    // Implementation of the row classification, see MarchingCubesClassify.cpp
+    enum ClassifyKernel {
+		CLASSIFY_AUTO,			// the best one supported by the CPU
+		CLASSIFY_SCALAR,
+		CLASSIFY_SSE4,
+		CLASSIFY_AVX2
+    };
+
     // Description of one combination of corners
     //  stores its own index, number of triangles with triangle table,
     //	and normal used during data generation
     //	it also have specific plane flags for ambiguous cases resolution
     struct  MarchingCubesCase {
-		int				index;
-		int				numTri;
-		TriangleI		tris[8];
+		int				index = 0;
+		int				numTri = 0;
+		TriangleI		tris[8] = {};
         Vector3F		normal[8];
 
-		unsigned char	capPlanes;
-		char			capPlanesTab[6];
+		unsigned char	capPlanes = 0;
+		char			capPlanesTab[6] = {};
+    };
+
+    // the same analysis as the runtime generator, but evaluated by the compiler - see MarchingCubesTable.h
+    class	Table;
+
+    // case data used during generation: corners, edges and sides of a cube and all 256 cases
+    //		it never changes once it's built, so any number of MarchingCubes objects read one table without locks,
+    //		each object is only a context with its own corner values, cache, output and statistics
+    struct CaseTable {
+		// positions of all corners in a cube
+		Vector3F			vertexOffset[8];
+		// 12 edges, each stored as 2 vertex indices
+		int					edgeToVertex[12][2];
+		// 4 vertices and 4 edges of each side of a cube
+		int					planeToVertex[6][4];
+		int					planeToEdge[6][4];
+		// triangles of each case
+		MarchingCubesCase	triangleTable[256];
+
+		// edges used by triangles of each case and edges of each side of a cube, as bit masks
+		unsigned short		caseEdges[256];
+		unsigned short		planeEdges[6];
+
+		// fills caseEdges and planeEdges from the rest of the table
+		constexpr void		fillEdgeMasks() {
+			for( int code = 0; code < 256; code++ ) {
+				caseEdges[code] = 0;
+				for( int t = 0; t < triangleTable[code].numTri; t++ )
+				for( int i = 0; i < 3; i++ )
+					caseEdges[code] |= 1 << triangleTable[code].tris[t][i];
+			}
+			for( int plane = 0; plane < 6; plane++ ) {
+				planeEdges[plane] = 0;
+				for( int i = 0; i < 4; i++ )
+					planeEdges[plane] |= 1 << planeToEdge[plane][i];
+			}
+		}
     };
 
 private:
-    VoxelField& field;
+    // the field being generated, workers of fillInTrianglesBatch are moved from one field to another
+    VoxelField* field;
 
-    // main table storing all geometry data, it's generated during initialization and used for rendering
-    MarchingCubesCase	triangleTable[256];
+    // all geometry data of the cases, shared with other objects - see CaseTable
+    const CaseTable*	table;
+
+    // the table written by the runtime generator, only while checkTable runs, 'table' points to it then
+    CaseTable*			genTable;
 
     // stores statistics for each case telling how many times it was used
     int                 usageStats[256];
@@ -156,18 +476,8 @@ private:
     // temporary table of corner values
     float               vertex[8];
 
-    // positions of all corners in a cube
-    Vector3F            vertexOffset[8];
-
-    // definition of edges, we have 12 of them, each is stored as 2 vertex indices
-    // they will be also computed at runtime
-    int                 edgeToVertex[12][2];
-
-    // for each side of a cube we store 4 vertices belonging to it
-	int					planeToVertex[6][4];
-
-    // for each side of a cube we store 4 edges belonging to it
-	int					planeToEdge[6][4];
+    // corners with values at least this big are inside of the surface, see setIsoValue
+    float               isoValue;
 
 
 	// index of the first free triangle in buffer
@@ -176,6 +486,9 @@ private:
 	// index of the first free vertex in cache
 	int					currentVertex;
 
+	// set when some cubes were skipped because the triangle buffer was full
+	bool				truncated;
+
     // returns index of axis parallel to the edge
     int         _getEdgeAxis( int edge );
 
@@ -195,7 +508,104 @@ private:
     bool        _twoBitsDiff( int v1, int v2 );
 
 
-	int			_capPlane( MarchingCubes::Vertex* vert, MarchingCubes::TriangleI* tris, int x, int y, int z, int plane, int side );
+	// buffers the current fill writes to, 'outMesh' or 'outMeshSoA' is set if they belong to a mesh which can grow
+	//	they may hold only a window of the geometry, the first element is vertex outVertBase and triangle outTriBase
+	//	positions and normals are addressed with a byte stride, so the same code writes Vertex arrays and separate arrays
+	char*				outPos;
+	char*				outNorm;
+	int					outVertStride;
+	TriangleI*			outTris;
+	int					outMaxVert;
+	int					outMaxTris;
+	int					outVertBase;
+	int					outTriBase;
+	Mesh*				outMesh;
+	MeshSoA*			outMeshSoA;
+
+	Vector3F&	_outPos( int index ) {
+		return *(Vector3F*)( outPos + (index - outVertBase) * outVertStride );
+	}
+	Vector3F&	_outNorm( int index ) {
+		return *(Vector3F*)( outNorm + (index - outVertBase) * outVertStride );
+	}
+	void		_setTriangle( int i0, int i1, int i2 ) {
+		TriangleI& tri = outTris[ currentTriangle - outTriBase ];
+		tri.i[0] = i0;
+		tri.i[1] = i1;
+		tri.i[2] = i2;
+	}
+
+	// one cube adds at most 8 triangles, 2 more for each of 3 cap planes shared with already visited cubes,
+	//	and at most one vertex per edge
+	static const int	CUBE_MAX_TRIS = 14;
+	static const int	CUBE_MAX_VERTS = 12;
+
+	// generates the whole field into the output set by _setOutput
+	int			_fillField( int& vertexNum, int& triNum );
+
+	// sets buffers for the next fill
+	void		_setOutput( Vertex* vert, int maxVert, TriangleI* tris, int maxTris );
+	void		_setOutput( Vector3F* pos, Vector3F* norm, int maxVert, TriangleI* tris, int maxTris );
+	void		_setOutput( Mesh& mesh );
+	void		_setOutput( MeshSoA& mesh );
+	// makes sure the next cube fits into the output, grows the mesh if there's one
+	//		returns false and sets 'truncated' if a fixed buffer is full
+	bool		_reserveCube() {
+		if( currentVertex - outVertBase <= outMaxVert - CUBE_MAX_VERTS &&
+			currentTriangle - outTriBase <= outMaxTris - CUBE_MAX_TRIS )
+			return true;
+		return _growOutput();
+	}
+	bool		_growOutput();
+
+	int			_capPlane( int x, int y, int z, int plane, int side );
+	// adds normals of both cap triangles to their vertices, only for NORMAL_TRIANGLES
+	void		_capPlaneNormals( const int index[4], int side );
+
+	// generates geometry of a single (x,y,z) cube, including cap planes shared with already visited cubes
+	//		corner values have to be set in 'vertex' already, 'code' is their case
+	void		_marchCube( int x, int y, int z, int code );
+	// generates all cubes of the (y,z) row, bricks which can't contain the surface are skipped if the field has a brick index
+	void		_marchRow( int y, int z ) {
+		_marchRow( y, z, 0, field->getSizeX()-1 );
+	}
+	// the same for cubes x0 <= x < x1 of the row
+	void		_marchRow( int y, int z, int x0, int x1 );
+	// classifies and generates cubes x0 <= x < x1 of the row from its 4 field rows, see _getRows
+	void		_marchSpan( const float* rows[4], int y, int z, int x0, int x1 );
+	// generates all cubes of the z layer in the order selected by setTraversalMode
+	//		a sparse field with the brick index is generated brick by brick, skipping bricks without the surface
+	void		_marchLayer( int z );
+
+	// generates all cubes of the (y,z) row from case codes computed before
+	void		_marchRowCodes( int y, int z, const unsigned char* codes );
+
+	// generates the (y,z) row for every level, each one a worker with its own isovalue, cache and output
+	//		rows are loaded once for all levels crossing the brick, see fillInTrianglesLevels
+	void		_marchRowLevels( int y, int z, MarchingCubes** levels, int levelNum );
+
+	// computes case codes of cubes x0 <= x < x1, rows are the 4 field rows holding their corners
+	void		_classifyRow( const float* rows[4], int x0, int x1, unsigned char* codes );
+	// computes case codes of all cubes of the z layer, cubes of skipped bricks get case 0 or 255
+	void		_classifyLayer( int z, unsigned char* codes );
+
+	// case codes of the row being generated
+	vector<unsigned char>	rowCodes;
+
+	// samples x0 <= x <= x1 of field rows (y,z), (y+1,z), (y,z+1) and (y+1,z+1), indexed by x
+	//		rows outside of the field are NULL, rows of a bricked field are copied to rowBuffer
+	void	_getRows( int y, int z, int x0, int x1, const float* rows[4] );
+	vector<float>			rowBuffer;
+
+	TraversalMode	traversalMode;
+	int				traversalTile;
+
+	// tiles of a layer in Morton order, x | y << 16 of the first cube of each tile
+	//		built for tileNumX * tileNumY tiles and rebuilt when the field or tile size changes
+	vector<int>		tileOrder;
+	int				tileNumX;
+	int				tileNumY;
+	void			_fillTileOrder( int numX, int numY );
 
 
 //  ++startup data++
@@ -205,6 +615,8 @@ private:
     void        _fillEdges();
 	// create planes helper tables
     void		_fillPlanes();
+	// create edge/plane to cache slot tables
+    void		_fillCacheSlots();
 
 	// returns index of edge connecting two vertices
     int         _findEdge( int v1, int v2 );
@@ -241,6 +653,11 @@ private:
     // gets an interpolated vector of given edge, based on its corner values
     Vector3F    getVertexFromEdge( int edgeNum );
 
+    // NORMAL_GRADIENT normal of a vertex at pos given in field coordinates, pos has to lie on an edge of the field
+    Vector3F    _gradientNormal( const Vector3F& pos );
+    // central difference of the field at the sample, one sided at the border
+    Vector3F    _fieldGradient( int x, int y, int z );
+
     // gets a center of given edge
     Vector3F    getHalfEdge( int edgeNum );
 
@@ -248,10 +665,6 @@ private:
     bool        _vertexIsNegByAxis( int v, int axis );
     Vector3F	_getNormalFromBits( int bits );
 
-    // prints all values from triangles table - for debug purposes
-    void        printTable();
-
-
 	//	tools
 	bool _differentSign( int a, int b );
 	bool _sameSign( int a, int b );
@@ -261,58 +674,356 @@ private:
 
 //  CACHE
 
-//	cache stores int value for every edge in the vertex field
-    // alloc cache x*y*z
-    int*    _cacheAlloc( int fieldX, int fieldY, int fieldZ );
+//	cache stores vertex index for every edge in the vertex field
+//	z is wrapped by cacheSizeZ, so a cache allocated for a few planes can serve any z-slab of the field
+//	entries are not cleared between fills, every one is stamped with the generation of its z plane
+//	and an entry with an old stamp is treated as empty
+
+	// one cache position/edge, also holds the cap plane perpendicular to that edge
+	struct CacheEntry {
+		unsigned int	gen;		// cacheGen + z of the plane when the entry was written
+		int				vertex;		// -1 if there's no vertex on the edge yet
+		signed char		capPlane;	// 0 if none of the cubes sharing the plane was visited yet,
+									//	otherwise capPlanesTab value of the first cube, waiting for the second one
+	};
+
+	// where an edge or plane of the cube at (x,y,z) lives in the cache:
+	//	position (x+dx, y+dy, z+dz), entry 'slot' of that position
+	struct CacheSlot {
+		int		dx, dy, dz;
+		int		slot;
+		int		offset;		// dx,dy and slot folded with current cache strides, updated by _cacheAlloc
+	};
+
+    // alloc cache x*y*z, or x*y*2 in rolling mode, kept as long as the size doesn't change
+    CacheEntry*	_cacheAlloc( int fieldX, int fieldY, int fieldZ );
     // free cache
     void    _cacheFree();
-    // set cache to -1
+    // invalidate all entries by starting a new generation
     void    _cacheClear();
 
 	// add a new vertex to the cache or return existing one
-    int     _cacheVertex( MarchingCubes::Vertex* vert, int x, int y, int z, int e );
+    int     _cacheVertex( int x, int y, int z, int e );
 
     // params: cube position (x,y,z), edge index
-    // returns: cache index for given edge
-    int     _cacheOffsetFromCubeEdge( int x, int y, int z, int e );
+    // returns: cache entry for given edge, reset if it was stale
+    CacheEntry*	_cacheEntry( int x, int y, int z, int e ) {
+		return _cacheEntryFromSlot( x,y,z, edgeToCacheSlot[e] );
+	}
     // params: cube position (x,y,z), plane index
-    // returns: cache index for given plane
-	int		_cacheOffsetFromPlane( int x, int y, int z, int plane );
+    // returns: cache entry holding given plane, reset if it was stale
+	CacheEntry*	_cacheEntryFromPlane( int x, int y, int z, int plane ) {
+		return _cacheEntryFromSlot( x,y,z, planeToCacheSlot[plane] );
+	}
+	CacheEntry*	_cacheEntryFromSlot( int x, int y, int z, const CacheSlot& s ) {
+		z += s.dz;
+		CacheEntry* entry = &cacheField[ x*3 + y*cacheRowStride + (z & (cacheSizeZ-1))*cachePlaneStride + s.offset ];
+
+		// written during an older fill or for another plane sharing the same memory
+		if( entry->gen != cacheGen + z ) {
+			entry->gen = cacheGen + z;
+			entry->vertex = -1;
+			entry->capPlane = 0;
+		}
+		return entry;
+	}
+
+	CacheSlot	edgeToCacheSlot[12];
+	CacheSlot	planeToCacheSlot[6];
+
+	// cache field - for each position 3 edges/planes going forward (facing -x, -y, -z)
+    CacheEntry*	cacheField;
+
+	// distance between neighbour rows and z planes in cacheField
+    int     cacheRowStride;
+    int     cachePlaneStride;
 
-	// cache field int[]
-    int*    cacheField;
+	// generation of plane z is cacheGen + z
+    unsigned int	cacheGen;
+	// the largest stamp which may be in the cache, the next generation starts above it
+	//		a deeper field filled before leaves stamps above cacheGen + z of the current one
+    unsigned int	cacheGenEnd;
 
     // cache size x, y, z
     int     cacheSizeX;
     int     cacheSizeY;
     int     cacheSizeZ;
 
-    // cache size x*y*z * 4
+    // cache size x*y*z * 3
     int     cacheSize;
 
+    CacheMode	cacheMode;
+
+    NormalMode	normalMode;
+
     int     vertexNum;
 
+//  PARALLEL
+
+	// geometry of one z-slab, vertex indices are local to the slab
+	struct SlabResult {
+		int					z0, z1;
+		Mesh				mesh;
+
+		// local vertex indices of x and y edges lying on the slab's bottom (z0) and top (z1) planes, -1 if none
+		vector<int>			bottomSeam;
+		vector<int>			topSeam;
+
+		// pairs of (local vertex, vertex of the lower slab) created by both slabs on the bottom plane
+		vector<int>			shared;
+
+		// placement in the merged mesh
+		int					vertBase;
+		int					triBase;
+		vector<int>			remap;
+	};
+
+	// kept between fills, so their meshes don't have to grow again
+	vector<SlabResult>	parallelSlabs;
+
+	// workers of fillInTrianglesBatch, one per thread, kept between batches together with their caches and buffers
+	vector<MarchingCubes*>	batchWorkers;
+
+//  CHUNKS
+
+	// generates the chunk and one cube around it into chunkScratch, then copies triangles of the chunk's own cubes
+	//		and their vertices to 'chunk', cubes around it are there only to complete normals of border vertices
+	void	_fillChunk( int cx, int cy, int cz, Mesh& chunk );
+
+	Mesh			chunkScratch;
+	// begin and end of triangles of the chunk's own cubes in chunkScratch, one pair per cube row
+	vector<int>		chunkTris;
+	// chunkScratch vertex to chunk vertex, -1 if it's not used by the chunk
+	vector<int>		chunkRemap;
+
+//  LOD
+
+	// field value used by lod chunks at the (x,y,z) sample
+	//		samples shared by chunks of different lods are interpolated from samples of the coarsest of them,
+	//		so all of these chunks see the same values and put vertices on shared edges at the same places
+	float	_lodSample( const LodMesh& mesh, int x, int y, int z );
+	// first and last field sample of the chunk and the number of its cubes at the lod, the last cube may be shorter
+	void	_lodChunkGrid( const LodMesh& mesh, const int pos[3], int lod, int lo[3], int hi[3], int num[3] );
+	// value of the g sample of a chunk at the lod, the way the chunk is generated - its border samples by _lodSample
+	float	_lodChunkSample( const LodMesh& mesh, const int lo[3], const int hi[3], const int num[3], int lod, const int g[3] );
+	void	_fillLodChunk( LodMesh& mesh, int cx, int cy, int cz, VoxelField& chunkField, MarchingCubes& worker );
+	// called on the worker after it generated a chunk of 'num' cubes, closes the gap between the chunk's face and
+	//		the face of a neighbour chunk with cubes 'ratio' times longer, see MarchingCubesLod.cpp
+	//		coarseCodes are the cases of the neighbour's cubes on the face, by coarse squares along u, then v
+	void	_stitchLodFace( int axis, int side, const int num[3], int ratio, const unsigned char* coarseCodes );
+	// vertex on the edge between face samples (i,j) and (i+di,j+dj), created if no cube of the chunk needed it
+	//		-1 if the surface doesn't cross the edge
+	int		_lodFaceVertex( int axis, int side, const int num[3], int i, int j, int di, int dj );
+
+//  STREAMING
+
+	// the part of the geometry streamTrianglesIndexed didn't pass to the sink yet
+	Mesh	streamWindow;
+
+	// passes vertices below vertEnd and triangles below triEnd to the sink and removes them from the window
+	template<class Sink>
+	void	_streamFlush( Sink& sink, int vertEnd, int triEnd );
+	// moves the rest of the window to its front
+	void	_streamCompact( int vertEnd, int triEnd );
+
+	// fillInTrianglesIndexedParallel into fixed buffers, or into the mesh resized to the merged geometry if it's set
+	int		_fillParallel( Vertex* vert, int maxVert, TriangleI* tris, int maxTris, Mesh* mesh,
+							int& vertexNum, int& triNum, int threadNum );
+	// generates all cubes with z0 <= z < z1 into the slab mesh
+	void	_fillSlab( SlabResult& slab );
+	// copies the slab's seam plane from the cache
+	void	_getSeam( int z, vector<int>& seam );
+
+	// two-pass extraction, see countTrianglesIndexed
+
+	// per position of a z plane: bit 'slot' is set if the edge owned by that position has a vertex
+	//		which happens if any cube sharing the edge uses it in a triangle or in a cap plane
+	vector<unsigned char>	planeMarks[2];
+	// case codes of the current and the previous cube layer
+	vector<unsigned char>	layerCodes[2];
+
+	// marks vertices of planes z and z+1 used by cubes of the z layer, adds their triangle counts to rowTris[y]
+	//		codesBelow are codes of the z-1 layer, without them caps on the bottom faces aren't found
+	void	_markLayer( const unsigned char* codes, const unsigned char* codesBelow,
+						unsigned char* marks, unsigned char* marksAbove, int* rowTris );
+	// marks the layers of a slab one after another, calls planeDone( z ) when all vertices of plane z are known
+	//		and layerDone( z ) when both planes of the z layer are done
+	template<class P, class L>
+	void	_sweepSlab( int z0, int z1, int* rowTris, P planeDone, L layerDone );
+
+	// first pass for one slab - vertices of its planes and triangles of its rows
+	void	_countSlab( int z0, int z1, int* rowVerts, int* rowTris );
+	// second pass for one slab - writes its vertices and triangles at offsets found by the first pass
+	//		vertices of the boundary planes are written only if 'boundaries' is set
+	void	_fillSlabCounted( int z0, int z1, bool boundaries, const int* vertBase, const int* triBase,
+								MarchingCubes::Vertex* vert, MarchingCubes::TriangleI* tris );
+
+	// first vertex of every (y,z) field row and first triangle of every (y,z) cube row, the last one is the total
+	vector<int>		countVertBase;
+	vector<int>		countTriBase;
+	int				countThreadNum;
+	// field, its size and the isovalue the counts were made for
+	const VoxelField*	countField;
+	int				countSize[3];
+	float			countIsoValue;
+	// whether the counts are there and were made for the current field, size and isovalue
+	bool	_countsMatch() const;
+
+	// worker objects take settings of the master object and share its table, but have their own cache
+    MarchingCubes( const MarchingCubes& master );
+    // worker generating another field, lod chunks are sampled into a field of their own
+    MarchingCubes( const MarchingCubes& master, VoxelField& f );
+    MarchingCubes& operator= ( const MarchingCubes& );
+
 public:
     MarchingCubes( VoxelField& f );
+    ~MarchingCubes();
 
-    // init entire geometry
+    // every object uses the table computed at compile time from its creation, so there's nothing left to do
+    //		kept for older code, one object per thread can generate without calling it
     void init();
 
+    // runs the runtime triangle table generator and compares its result with the compile time table
+    //		returns true if both are the same, the object uses the shared table again afterwards
+    bool checkTable();
+
+    // the table computed at compile time, used by all objects
+    static const CaseTable&	getSharedTable();
+
+    // prints all values from triangles table - for debug purposes
+    void        printTable();
+
     // sets corner values
     void setValues( Cube2& cube );
 
 	// get Marching Cubes Case by index
-    MarchingCubesCase&    getCase( int code ) {
-        return triangleTable[code];
+    const MarchingCubesCase&    getCase( int code ) {
+        return table->triangleTable[code];
     }
 	// get Marching Cubes Case by values
-    MarchingCubesCase&    getCaseFromValues() {
+    const MarchingCubesCase&    getCaseFromValues() {
         int code = _bitsToCode( vertex );
         return getCase( code );
     }
 
 	// fill in geometry data for current frame
+	//		cubes which don't fit into maxVert vertices or maxTris triangles are skipped, see wasTruncated
     int     fillInTrianglesIndexed( MarchingCubes::Vertex* vert, int maxVert, MarchingCubes::TriangleI* tris, int maxTris, int& vertexNum, int& triNum );
+	// the same, but the mesh grows to hold the whole geometry
+    int     fillInTrianglesIndexed( Mesh& mesh );
+	// the same with positions and normals written to separate arrays
+    int     fillInTrianglesIndexed( MarchingCubes::Vector3F* pos, MarchingCubes::Vector3F* norm, int maxVert,
+									MarchingCubes::TriangleI* tris, int maxTris, int& vertexNum, int& triNum );
+    int     fillInTrianglesIndexed( MeshSoA& mesh );
+
+	// the same as fillInTrianglesIndexed, but the field is split into z-slabs generated by 'threadNum' threads
+	//		slabs are merged into one indexed mesh, vertices on slab boundaries are shared
+	//		if the output doesn't fit, whole slabs are dropped from the end
+	//		threadNum <= 0 uses all hardware threads
+    int     fillInTrianglesIndexedParallel( MarchingCubes::Vertex* vert, int maxVert, MarchingCubes::TriangleI* tris, int maxTris,
+											int& vertexNum, int& triNum, int threadNum );
+    int     fillInTrianglesIndexedParallel( Mesh& mesh, int threadNum );
+
+	// generates each of fieldNum separate fields into its own mesh, meshes[i] gets the geometry and counts of fields[i]
+	//		meant for many small volumes - workers keep their vertex cache and buffers from field to field and from batch
+	//		to batch, so fields of the same size don't allocate anything, meshes only grow until they fit
+	//		fields are spread over 'threadNum' threads, threadNum <= 0 uses all hardware threads
+	//		returns number of triangles of all meshes
+    int     fillInTrianglesBatch( VoxelField* const* fields, int fieldNum, Mesh* meshes, int threadNum = 1 );
+
+	// the first pass of the two-pass extraction, counts vertices and triangles of the current field exactly
+	//		allocate the output with those sizes and call fillInTrianglesIndexedCounted, the field can't change in between
+	//		threadNum <= 0 uses all hardware threads
+    void    countTrianglesIndexed( int& vertexNum, int& triNum, int threadNum );
+
+	// the second pass, vert and tris have to hold vertexNum and triNum elements returned by countTrianglesIndexed
+	//		gives the same mesh as fillInTrianglesIndexed, all threads write straight to the output and it's never truncated
+	//		returns 0 without writing anything if the field, its size or the isovalue changed since counting
+    int     fillInTrianglesIndexedCounted( MarchingCubes::Vertex* vert, MarchingCubes::TriangleI* tris );
+	// the same, the mesh is resized to the counted size, stale counts are made again
+    int     fillInTrianglesIndexedCounted( Mesh& mesh );
+
+	// generates the field and pushes the geometry to 'sink' while it's generated, instead of filling a mesh
+	//		only geometry of the last two cube layers is kept, so memory doesn't depend on the size of the mesh
+	//		sink is any object with methods:
+	//			void vertex( int index, const Vector3F& pos, const Vector3F& norm );	- in index order, the normal is final
+	//			void triangle( const TriangleI& tri );									- after all 3 of its vertices
+	//		returns number of triangles
+	template<class Sink>
+	int		streamTrianglesIndexed( Sink& sink );
+
+	// re-meshes chunks holding dirty bricks of the field and clears its dirty flags
+	//		the first update and updates after the size of the field changed generate all chunks
+	//		dirty flags belong to the field, so only one chunked mesh per field can be updated this way
+	//		returns number of generated chunks, see ChunkedMesh::getUpdatedChunks
+    int     updateChunkedMesh( ChunkedMesh& mesh );
+
+	// splits the field into lod chunks of 2^chunkShift cubes, all of them at lod 0
+    void    initLodMesh( LodMesh& mesh, int chunkShift );
+	// lods from the distance between 'eye' and the box of every chunk in field coordinates
+	//		chunks closer than 'distance' get lod 0, every next lod starts twice as far, up to maxLod
+    void    selectLods( LodMesh& mesh, const Vector3F& eye, float distance, int maxLod );
+	// generates all chunks at their lods, a mesh which doesn't match the field is split again first
+	//		returns the number of triangles of all chunks
+    int     fillInTrianglesLod( LodMesh& mesh );
+
+	// generates the field into compact vertices, streamed and quantized layer by layer
+    int     fillInTrianglesCompact( CompactMesh& mesh );
+
+	// generates the surface of every one of levelNum isovalues into its own mesh, in a single pass over the field
+	//		samples of every row are loaded once and classified against all levels, cubes always go by rows
+	//		returns number of triangles of all meshes
+    int     fillInTrianglesLevels( const float* isoValues, int levelNum, Mesh* meshes );
+
+	// selects the vertex cache used by next fills, CACHE_ROLLING by default
+    void    setCacheMode( CacheMode mode ) {
+		if( mode != cacheMode )
+			_cacheFree();
+		cacheMode = mode;
+	}
+    CacheMode	getCacheMode() {
+		return cacheMode;
+	}
+
+	// selects how next fills compute vertex normals, NORMAL_TRIANGLES by default
+	//		fillInTrianglesLod always uses triangle normals of the simplified chunks
+	//		NORMAL_GRADIENT reads samples two cells beyond a cube, so a sparse field has to be pruned with a ring of 2
+    void    setNormalMode( NormalMode mode ) {
+		normalMode = mode;
+	}
+    NormalMode	getNormalMode() {
+		return normalMode;
+	}
+
+	// the surface goes where the field has this value, 0 by default, values at least this big are inside
+	//		the brick index and classification follow it, a sparse field has to be pruned with this value kept
+    void    setIsoValue( float value ) {
+		isoValue = value;
+	}
+    float	getIsoValue() {
+		return isoValue;
+	}
+
+	// selects the order of cubes inside a z layer used by next fills, TRAVERSAL_ROWS by default
+	//		tileSize is the edge of a tile in cubes, the two-pass extraction always goes by rows
+    void    setTraversalMode( TraversalMode mode, int tileSize = 16 ) {
+		traversalMode = mode;
+		traversalTile = max( tileSize, 1 );
+		tileNumX = tileNumY = 0;
+	}
+    TraversalMode	getTraversalMode() {
+		return traversalMode;
+	}
+
+	// selects the classification kernel for all objects, returns false if the CPU doesn't support it
+	//		it shouldn't be called while some fill is running
+    static bool				setClassifyKernel( ClassifyKernel kernel );
+    static ClassifyKernel	getClassifyKernel();
+
+	// true if the last fill didn't fit into the output buffers and some geometry is missing
+    bool    wasTruncated() {
+		return truncated;
+	}
 
 	// get usage statistics for a given case
     int     getUsageStats( int i ) {
@@ -328,10 +1039,54 @@ public:
         cross[1] = (v1[2]*v2[0]) - (v2[2]*v1[0]);
         cross[2] = (v1[0]*v2[1]) - (v2[0]*v1[1]);
     }
-    static float dotProduct( MarchingCubes::Vector3F v1, MarchingCubes::Vector3F v2 ) {
+    static constexpr float dotProduct( MarchingCubes::Vector3F v1, MarchingCubes::Vector3F v2 ) {
     return v1.f[0]*v2.f[0] +
             v1.f[1]*v2.f[1] +
             v1.f[2]*v2.f[2];
     }
 };
+
+template<class Sink>
+int MarchingCubes::streamTrianglesIndexed( Sink& sink )
+{
+	_cacheAlloc( field->getSizeX(), field->getSizeY(), field->getSizeZ() );
+	_cacheClear();
+	_setOutput( streamWindow );
+
+	currentTriangle	= 0;
+	currentVertex	= 0;
+	truncated		= false;
+
+	int layerVertEnd = 0;
+	int layerTriEnd = 0;
+	for( int z = 0; z < field->getSizeZ()-1; z++ )
+	{
+		_marchLayer( z );
+
+		// vertices created before this layer lie on planes up to z, no cube left touches them
+		// and triangles of the previous layer use only those vertices
+		_streamFlush( sink, layerVertEnd, layerTriEnd );
+		layerVertEnd = currentVertex;
+		layerTriEnd = currentTriangle;
+	}
+	_streamFlush( sink, currentVertex, currentTriangle );
+
+	return currentTriangle;
+}
+
+template<class Sink>
+void MarchingCubes::_streamFlush( Sink& sink, int vertEnd, int triEnd )
+{
+	for( int v = outVertBase; v < vertEnd; v++ ) {
+		Vector3F& norm = _outNorm( v );
+		if( normalMode == NORMAL_TRIANGLES )
+			norm.normalise();
+		sink.vertex( v, _outPos( v ), norm );
+	}
+	for( int t = outTriBase; t < triEnd; t++ )
+		sink.triangle( outTris[ t - outTriBase ] );
+
+	_streamCompact( vertEnd, triEnd );
+}
+
 #endif // MARCHINGCUBES_H
@@ -0,0 +1,514 @@
+/*
+    MarchingCubes - main class for all Marching Cubes computations
+    Author: Karol Herda
+    Web:    http://kolenda.me/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Compile time generation of the triangle table
+
+    Table repeats the analysis from MarchingCubesAnalyze.cpp with constexpr methods,
+    so all 256 cases are computed by the compiler and all MarchingCubes objects share the result:
+
+        constexpr MarchingCubes::Table table;
+
+    The runtime generator is kept, MarchingCubes::checkTable() compares both results.
+    Methods have the same names as their runtime versions, only std::set and the
+    linear edge search are replaced, so the analysis fits into compiler evaluation limits.
+*/
+
+#ifndef MARCHINGCUBESTABLE_H
+#define MARCHINGCUBESTABLE_H
+
+#include "MarchingCubes.h"
+
+class MarchingCubes::Table
+{
+public:
+    Vector3F			vertexOffset[8];
+    int					edgeToVertex[12][2];
+	int					planeToVertex[6][4];
+	int					planeToEdge[6][4];
+    MarchingCubesCase	triangleTable[256];
+
+    constexpr Table() : vertexOffset(), edgeToVertex(), planeToVertex(), planeToEdge(), triangleTable(), vertexPairToEdge()
+    {
+		_fillVertices();
+		_fillEdges();
+		_fillPlanes();
+		generateTriangles();
+    }
+
+private:
+	// index of edge connecting two corners, -1 if they aren't neighbours
+	int					vertexPairToEdge[8][8];
+
+//  ++tools++
+    static constexpr bool _oneBitDiff( int v1, int v2 ) {
+		return (v1 ^ v2) == 1 || (v1 ^ v2) == 2 || (v1 ^ v2) == 4;
+    }
+    static constexpr bool _sameSign( int a, int b ) {
+		return (a >= 0) == (b >= 0);
+    }
+    static constexpr bool _vertexIsNegByAxis( int v, int axis ) {
+		return !(v & (1<<axis));
+    }
+    static constexpr bool _vertexIsAtAxisSide( int v, int axis, int sign ) {
+		return sign ? (v & (1<<axis)) != 0 : !(v & (1<<axis));
+    }
+    static constexpr int _planeFromAxisSign( int axis, int sign ) {
+		return axis * 2 + sign;
+    }
+    static constexpr int _planeToAxis( int plane ) {
+		return plane / 2;
+    }
+    static constexpr int _planeToSign( int plane ) {
+		return plane % 2;
+    }
+	static constexpr int _getVertexBySymmetry( int vertex, int axis ) {
+		return vertex ^ (1<<axis);
+	}
+    static constexpr void _codeToSignTable( int code, int* tab ) {
+		for( int counter = 0; counter < 8; counter++ )
+			tab[counter] = (code & (1 << counter)) ? 1 : -1;
+    }
+    static constexpr Vector3F _getNormalFromBits( int bits ) {
+		return Vector3F( (bits&1) ? 1.0f : -1.0f, (bits&2) ? 1.0f : -1.0f, (bits&4) ? 1.0f : -1.0f );
+    }
+	static constexpr Vector3F getTriangleNormal( const Vector3F& v0, const Vector3F& v1, const Vector3F& v2 ) {
+		Vector3F d1 = v1 - v0;
+		Vector3F d2 = v2 - v0;
+		return Vector3F( (d1.f[1]*d2.f[2]) - (d2.f[1]*d1.f[2]),
+						 (d1.f[2]*d2.f[0]) - (d2.f[2]*d1.f[0]),
+						 (d1.f[0]*d2.f[1]) - (d2.f[0]*d1.f[1]) );
+	}
+
+    constexpr int _findEdge( int v1, int v2 ) const {
+		return vertexPairToEdge[v1][v2];
+    }
+    constexpr int _getEdgeBySymmetry( int edge, int axis ) const {
+		return _findEdge( _getVertexBySymmetry( edgeToVertex[edge][0], axis ),
+						  _getVertexBySymmetry( edgeToVertex[edge][1], axis ) );
+    }
+    constexpr int _getEdgeAxis( int edge ) const {
+		int diff = edgeToVertex[edge][0] ^ edgeToVertex[edge][1];
+		return diff == 1 ? 0 : diff == 2 ? 1 : diff == 4 ? 2 : -1;
+    }
+    constexpr void _getEdgesAlongAxis( int axis, int edges[4] ) const {
+		int counter = 0;
+		for( int edge = 0; edge < 12; edge++ ) {
+			if( _vertexIsNegByAxis(edgeToVertex[edge][0],axis) !=
+				_vertexIsNegByAxis(edgeToVertex[edge][1],axis) )
+				edges[counter++] = edge;
+		}
+    }
+    constexpr Vector3F getHalfEdge( int edgeNum ) const {
+		const Vector3F& v1 = vertexOffset[ edgeToVertex[edgeNum][0] ];
+		const Vector3F& v2 = vertexOffset[ edgeToVertex[edgeNum][1] ];
+		return Vector3F( (v1.f[0]+v2.f[0]) / 2, (v1.f[1]+v2.f[1]) / 2, (v1.f[2]+v2.f[2]) / 2 );
+    }
+//  --tools--
+
+//  ++startup data++
+    constexpr void _fillVertices() {
+		for( int v = 0; v < 8; v++ )
+			vertexOffset[v] = Vector3F( (v&1) ? 1.0f : 0.0f, (v&2) ? 1.0f : 0.0f, (v&4) ? 1.0f : 0.0f );
+    }
+
+    constexpr void _fillEdges() {
+		for( int v1 = 0; v1 < 8; v1++ )
+			for( int v2 = 0; v2 < 8; v2++ )
+				vertexPairToEdge[v1][v2] = -1;
+
+		int edgesNum = 0;
+		for( int v1 = 0; v1 < 7; v1++ ) {
+			for( int v2 = v1+1; v2 < 8; v2++ ) {
+				if( _oneBitDiff(v1,v2) ) {
+					edgeToVertex[edgesNum][0] = v1;
+					edgeToVertex[edgesNum][1] = v2;
+					vertexPairToEdge[v1][v2] = edgesNum;
+					vertexPairToEdge[v2][v1] = edgesNum;
+					edgesNum++;
+				}
+			}
+		}
+    }
+
+	constexpr int _fixPlaneEdgesNormal( int plane, int planeEdges[4] ) const {
+		Vector3F normal = getTriangleNormal( getHalfEdge( planeEdges[0] ), getHalfEdge( planeEdges[1] ), getHalfEdge( planeEdges[2] ) );
+
+		int axis = _planeToAxis( plane );
+		float dot = _planeToSign( plane ) ? normal.f[axis] : -normal.f[axis];
+		if( dot < 0.0f ) {
+			int tmp = planeEdges[1];
+			planeEdges[1] = planeEdges[2];
+			planeEdges[2] = tmp;
+			return 1;
+		}
+		else if( dot == 0.0f )
+			throw "_fixPlaneEdgesNormal: zero dot product error!";
+		return 0;
+	}
+
+    constexpr void _fillPlanes() {
+		for( int axis = 0; axis < 3; axis++ ) {
+			for( int sign = 0; sign < 2; sign++ ) {
+				int plane = _planeFromAxisSign( axis, sign );
+
+				int edgeCounter = 0;
+				int vertexCounter = 0;
+
+				for( int edge = 0; edge < 12; edge++ ) {
+					if( _vertexIsAtAxisSide( edgeToVertex[edge][0], axis, sign ) &&
+						_vertexIsAtAxisSide( edgeToVertex[edge][1], axis, sign ) )
+							planeToEdge[plane][edgeCounter++] = edge;
+				}
+
+				_fixPlaneEdgesNormal( plane, planeToEdge[plane] );
+
+				for( int vert = 0; vert < 8; vert++ ) {
+					if( _vertexIsAtAxisSide( vert, axis, sign ) )
+						planeToVertex[plane][vertexCounter++] = vert;
+				}
+			}
+		}
+    }
+//  --startup data--
+
+//  ++triangle table generation++
+	constexpr void _addTriangle( MarchingCubesCase& cubeCase, const Vector3F& normal, int e1, int e2, int e3 ) {
+		cubeCase.normal[cubeCase.numTri] = normal;
+		cubeCase.tris[ cubeCase.numTri ][0] = e1;
+		cubeCase.tris[ cubeCase.numTri ][1] = e2;
+		cubeCase.tris[ cubeCase.numTri ][2] = e3;
+		cubeCase.numTri++;
+	}
+
+    constexpr int generateTriangles() {
+		triangleTable[0].index = triangleTable[0].numTri = 0;
+		triangleTable[255].index = 255;
+		triangleTable[255].numTri = 0;
+
+		for( int i = 1; i < 255; i++ ) {
+			triangleTable[i].index = i;
+
+			_findSingleVertexTriangles( i );
+			_findEdgeTriangles( i );
+			_findHalfSplit( i );
+			_findTripleVertex( i );
+			_findFourVertex( i );
+			_findSnake( i );
+
+			_fixTrianglesNormals( i );
+
+			_selectCapPlanes( i );
+		}
+		return 1;
+    }
+
+    constexpr int _findSingleVertexTriangles( int code ) {
+		int counter = 0;
+		int signTab[8] = {};
+		_codeToSignTable( code, signTab );
+		MarchingCubesCase& cubeCase = triangleTable[code];
+
+		bool singleVertexMap[8] = {};
+		for( int v = 0; v < 8; v++ ) {
+			int vRefl[3] = { _getVertexBySymmetry( v, 0 ), _getVertexBySymmetry( v, 1 ), _getVertexBySymmetry( v, 2 ) };
+
+			if( signTab[v] >= 0 && signTab[vRefl[0]] < 0 && signTab[vRefl[1]] < 0 && signTab[vRefl[2]] < 0 ) {
+				_addTriangle( cubeCase, _getNormalFromBits( 7-v ),
+								_findEdge( v, vRefl[0] ), _findEdge( v, vRefl[1] ), _findEdge( v, vRefl[2] ) );
+				singleVertexMap[v] = true;
+				counter++;
+			}
+		}
+		for( int v = 0; v < 8; v++ ) {
+			int vRefl[3] = { _getVertexBySymmetry( v, 0 ), _getVertexBySymmetry( v, 1 ), _getVertexBySymmetry( v, 2 ) };
+
+			if( signTab[v] < 0 && signTab[vRefl[0]] >= 0 && signTab[vRefl[1]] >= 0 && signTab[vRefl[2]] >= 0 &&
+				!singleVertexMap[ vRefl[0] ] && !singleVertexMap[ vRefl[1] ] && !singleVertexMap[ vRefl[2] ] ) {
+				_addTriangle( cubeCase, _getNormalFromBits( v ),
+								_findEdge( v, vRefl[0] ), _findEdge( v, vRefl[1] ), _findEdge( v, vRefl[2] ) );
+				singleVertexMap[v] = true;
+				counter++;
+			}
+		}
+		return counter;
+    }
+
+    constexpr int _findEdgeTriangles( int code ) {
+		int counter = 0;
+		int signTab[8] = {};
+		_codeToSignTable( code, signTab );
+		MarchingCubesCase& cubeCase = triangleTable[code];
+
+		for( int e = 0; e < 12; e++ ) {
+			int v1 = edgeToVertex[e][0];
+			int v2 = edgeToVertex[e][1];
+			int edgeAxis = _getEdgeAxis(e);
+
+			bool failed = signTab[v1] != signTab[v2];
+			for( int i = 1; i < 3 && !failed; i++ ) {
+				int ax = (edgeAxis+i)%3;
+				if( _sameSign( signTab[v1], signTab[ _getVertexBySymmetry( v1, ax ) ] ) ||
+					_sameSign( signTab[v2], signTab[ _getVertexBySymmetry( v2, ax ) ] ) )
+					failed = true;
+			}
+			if( !failed ) {
+				Vector3F normal = _getNormalFromBits( signTab[v1] < 0 ? v1 : 7-v1 );
+				int e11 = _findEdge( v1, _getVertexBySymmetry(v1,(edgeAxis+1)%3) );
+				int e12 = _findEdge( v1, _getVertexBySymmetry(v1,(edgeAxis+2)%3) );
+				int e21 = _findEdge( v2, _getVertexBySymmetry(v2,(edgeAxis+1)%3) );
+				int e22 = _findEdge( v2, _getVertexBySymmetry(v2,(edgeAxis+2)%3) );
+
+				_addTriangle( cubeCase, normal, e11, e12, e22 );
+				_addTriangle( cubeCase, normal, e22, e21, e11 );
+				counter+=2;
+			}
+		}
+		return counter;
+    }
+
+    constexpr int _findHalfSplit( int code ) {
+		int counter = 0;
+		int signTab[8] = {};
+		_codeToSignTable( code, signTab );
+		MarchingCubesCase& cubeCase = triangleTable[code];
+
+		for( int axis = 0; axis < 3; axis++ ) {
+			bool casePosFail = false;
+			bool caseNegFail = false;
+
+			for( int v = 0; v < 8; v++ ) {
+				// negative corners inside and positive outside, or the opposite
+				if( _vertexIsNegByAxis(v,axis) != (signTab[v] < 0) )
+					casePosFail = true;
+				else
+					caseNegFail = true;
+			}
+			for( int side = 0; side < 2; side++ ) {
+				if( side == 0 ? casePosFail : caseNegFail )
+					continue;
+
+				int edges[4] = {};
+				_getEdgesAlongAxis( axis, edges );
+
+				int startEdge = edges[0];
+				int edge1	= _getEdgeBySymmetry( startEdge, (axis+1)%3 );
+				int edge2	= _getEdgeBySymmetry( startEdge, (axis+2)%3 );
+				int endEdge	= _getEdgeBySymmetry( edge2, (axis+1)%3 );
+
+				Vector3F normal = _getNormalFromBits( side == 0 ? 0 : 7 );
+				_addTriangle( cubeCase, normal, startEdge, edge1, edge2 );
+				_addTriangle( cubeCase, normal, edge1, endEdge, edge2 );
+				counter+=2;
+			}
+		}
+		return counter;
+    }
+
+    constexpr int _findTripleVertex( int code ) {
+		int signTab[8] = {};
+		_codeToSignTable( code, signTab );
+		MarchingCubesCase& cubeCase = triangleTable[code];
+
+		for( int v = 0; v < 8; v++ ) {
+			for( int axis = 0; axis < 3; axis++ ) {
+				int vRefl1 = _getVertexBySymmetry( v, (axis+1)%3 );
+				int vRefl2 = _getVertexBySymmetry( v, (axis+2)%3 );
+				int vRefl12 = _getVertexBySymmetry( vRefl1, (axis+2)%3 );
+
+				int vReflA = _getVertexBySymmetry( v, axis );
+				int vRefl1A = _getVertexBySymmetry( vRefl1, axis );
+				int vRefl2A = _getVertexBySymmetry( vRefl2, axis );
+
+				// the same test for both signs, 's' is sign of the three corners
+				for( int s = -1; s <= 1; s += 2 ) {
+					if( signTab[v] * s > 0 && signTab[vRefl1] * s > 0 && signTab[vRefl2] * s > 0 &&
+						signTab[vReflA] * s < 0 && signTab[vRefl1A] * s < 0 && signTab[vRefl2A] * s < 0 &&
+						signTab[vRefl12] * s < 0 )
+					{
+						int e2_2A	= _findEdge(vRefl2, vRefl2A);
+						int e1_1A	= _findEdge(vRefl1, vRefl1A);
+						int e1_12	= _findEdge(vRefl1, vRefl12);
+						int e2_12	= _findEdge(vRefl2, vRefl12);
+						int e_A		= _findEdge(v, vReflA);
+
+						if( s < 0 ) {
+							Vector3F normal = _getNormalFromBits( v );
+							_addTriangle( cubeCase, normal, e2_2A, e1_1A, e1_12 );
+							_addTriangle( cubeCase, normal, e1_12, e2_12, e2_2A );
+							_addTriangle( cubeCase, normal, e2_2A, e_A, e1_1A );
+						}
+						else {
+							Vector3F normal = _getNormalFromBits( 7-v );
+							_addTriangle( cubeCase, normal, e2_2A, e1_12, e1_1A );
+							_addTriangle( cubeCase, normal, e1_12, e2_2A, e2_12 );
+							_addTriangle( cubeCase, normal, e2_2A, e1_1A, e_A );
+						}
+						return 3;
+					}
+				}
+			}
+		}
+		return 0;
+    }
+
+    constexpr int _findFourVertex( int code ) {
+		int counter = 0;
+		int signTab[8] = {};
+		_codeToSignTable( code, signTab );
+		MarchingCubesCase& cubeCase = triangleTable[code];
+
+		for( int v = 0; v < 8; v++ ) {
+			int vRefl1 = _getVertexBySymmetry( v, 0 );
+			int vRefl2 = _getVertexBySymmetry( v, 1 );
+			int vRefl3 = _getVertexBySymmetry( v, 2 );
+			int vRefl12 = _getVertexBySymmetry( vRefl1, 1 );
+			int vRefl13 = _getVertexBySymmetry( vRefl1, 2 );
+			int vRefl23 = _getVertexBySymmetry( vRefl2, 2 );
+			int vRefl123 = _getVertexBySymmetry( vRefl12, 2 );
+
+			if( signTab[v] < 0 && signTab[vRefl1] < 0 && signTab[vRefl2] < 0 && signTab[vRefl3] < 0 &&
+				signTab[vRefl12] > 0 && signTab[vRefl13] > 0 && signTab[vRefl23] > 0 && signTab[vRefl123] > 0 )
+			{
+				Vector3F normal = _getNormalFromBits( v );
+				_addTriangle( cubeCase, normal, _findEdge(vRefl1, vRefl13), _findEdge(vRefl1, vRefl12), _findEdge(vRefl2, vRefl12) );
+				_addTriangle( cubeCase, normal, _findEdge(vRefl3, vRefl13), _findEdge(vRefl1, vRefl13), _findEdge(vRefl2, vRefl12) );
+				_addTriangle( cubeCase, normal, _findEdge(vRefl3, vRefl13), _findEdge(vRefl2, vRefl12), _findEdge(vRefl2, vRefl23) );
+				_addTriangle( cubeCase, normal, _findEdge(vRefl3, vRefl13), _findEdge(vRefl2, vRefl23), _findEdge(vRefl3, vRefl23) );
+				counter+=4;
+			}
+		}
+		return counter;
+    }
+
+    constexpr int _findSnake( int code ) {
+		int signTab[8] = {};
+		_codeToSignTable( code, signTab );
+		MarchingCubesCase& cubeCase = triangleTable[code];
+
+		for( int v = 0; v < 8; v++ ) {
+			for( int ax1 = 0; ax1 < 3; ax1++ ) {
+				for( int ax2_ = ax1+1; ax2_ < ax1+3; ax2_++ ) {
+					int ax2 = ax2_ % 3;
+					int ax3 = 3 - (ax1+ax2);
+
+					int vRefl_1 = _getVertexBySymmetry( v, ax1 );
+					int vRefl_12 = _getVertexBySymmetry( vRefl_1, ax2 );
+					int vRefl_123 = _getVertexBySymmetry( vRefl_12, ax3 );
+
+					// corners of the path as bits, instead of std::set
+					int vertPath = (1<<v) | (1<<vRefl_1) | (1<<vRefl_12) | (1<<vRefl_123);
+
+					bool fail = false;
+					for( int i = 0; i < 8 && !fail; i++ ) {
+						bool found = (vertPath & (1<<i)) != 0;
+						if( (!found && signTab[i] < 0) || (found && signTab[i] > 0) )
+							fail = true;
+					}
+					if( !fail ) {
+						int vRefl_2 = _getVertexBySymmetry( v, ax2 );
+						int vRefl_3 = _getVertexBySymmetry( v, ax3 );
+						int vRefl_13 = _getVertexBySymmetry( vRefl_1, ax3 );
+						int vRefl_23 = _getVertexBySymmetry( vRefl_2, ax3 );
+
+						Vector3F normal = _getNormalFromBits( vRefl_1 );
+						_addTriangle( cubeCase, normal, _findEdge(v, vRefl_3), _findEdge(vRefl_1, vRefl_13), _findEdge(vRefl_123, vRefl_23) );
+						_addTriangle( cubeCase, normal, _findEdge(v, vRefl_2), _findEdge(v, vRefl_3), _findEdge(vRefl_123, vRefl_23) );
+						_addTriangle( cubeCase, normal, _findEdge(vRefl_2, vRefl_12), _findEdge(v, vRefl_2), _findEdge(vRefl_123, vRefl_23) );
+						_addTriangle( cubeCase, normal, _findEdge(vRefl_1, vRefl_13), _findEdge(vRefl_13, vRefl_123), _findEdge(vRefl_123, vRefl_23) );
+						return 4;
+					}
+				}
+			}
+		}
+		return 0;
+    }
+
+    constexpr int _selectCapPlanes( int code ) {
+		MarchingCubesCase& cubeCase = triangleTable[code];
+
+		for( int axis = 0; axis < 3; axis++ ) {
+			for( int sign = 0; sign < 2; sign++ ) {
+				int plane = _planeFromAxisSign( axis, sign );
+				const int* planeEdges = planeToEdge[plane];
+
+				cubeCase.capPlanesTab[plane] = 0;
+
+				int triangleOnPlaneCount = 0;
+				for( int tri = 0; tri < cubeCase.numTri; tri++ ) {
+					const TriangleI& triI = cubeCase.tris[tri];
+
+					int planeVertCount = 0;
+					for( int triVert = 0; triVert < 3; triVert++ ) {
+						for( int edgeIdx = 0; edgeIdx < 4; edgeIdx++ ) {
+							if( triI.i[triVert] == planeEdges[edgeIdx] )
+								planeVertCount++;
+						}
+					}
+					if( planeVertCount == 2 )
+						triangleOnPlaneCount++;
+
+					if( triangleOnPlaneCount == 2 ) {
+						Vector3F verts[3] = { getHalfEdge( triI.i[0] ), getHalfEdge( triI.i[1] ), getHalfEdge( triI.i[2] ) };
+						Vector3F normal = getTriangleNormal( verts[0], verts[1], verts[2] );
+
+						float val = normal.f[axis] * ((float)sign - 0.5f);
+
+						int planeSign = 0;
+						if( val > 0.0f )
+							planeSign = 1;
+						else if( val < 0.0f )
+							planeSign = -1;
+						else {
+							Vector3F triCenter = verts[0] + verts[1] + verts[2];
+							Vector3F triToCenter( 0.5f - triCenter.f[0] / 3.0f, 0.5f - triCenter.f[1] / 3.0f, 0.5f - triCenter.f[2] / 3.0f );
+
+							float dot = dotProduct( normal, triToCenter );
+							if( dot > 0 )
+								planeSign = 1;
+							else if( dot < 0 )
+								planeSign = -1;
+							else
+								throw "_selectCapPlanes: zero dot product error!";
+						}
+
+						if( sign == 0 )
+							planeSign = -planeSign;
+
+						cubeCase.capPlanesTab[plane] = planeSign;
+						break;
+					}
+				}
+			}
+		}
+
+		for( int i = 0; i < 6; i++ ) {
+			if( cubeCase.capPlanesTab[i] != 0 )
+				cubeCase.capPlanes = true;
+		}
+		return cubeCase.capPlanes;
+    }
+
+    constexpr int _fixTrianglesNormals( int code ) {
+		MarchingCubesCase& cubeCase = triangleTable[code];
+		int counter = 0;
+		for( int t = 0; t < cubeCase.numTri; t++ ) {
+			Vector3F normal = getTriangleNormal( getHalfEdge( cubeCase.tris[t][0] ),
+												 getHalfEdge( cubeCase.tris[t][1] ),
+												 getHalfEdge( cubeCase.tris[t][2] ) );
+
+			if( dotProduct( normal, cubeCase.normal[t] ) < 0 ) {
+				int tmp = cubeCase.tris[t][1];
+				cubeCase.tris[t][1] = cubeCase.tris[t][2];
+				cubeCase.tris[t][2] = tmp;
+				counter++;
+			}
+		}
+		return counter;
+    }
+//  --triangle table generation--
+};
+
+#endif // MARCHINGCUBESTABLE_H
@@ -12,6 +12,9 @@
 #define VOXELFIELD_H_INCLUDED
 
 #include <vector>
+#include <string>
+#include <mutex>
+#include <stdio.h>
 #include <math.h>
 #include <assert.h>
 #include <string.h>
@@ -43,36 +46,22 @@ public:
 };*/
 
 /*
-    Cube2 - the new version, aware of voxel field size
-    takes entire voxel field and returns particular cube values
+    Cube2 - the new version, filled by the voxel field
+    holds 8 corner values of a particular cube, corner bits are x, y and z
+    values are copied, because neighbour samples aren't at fixed distances in the bricked layout
 */
 class Cube2 {
 private:
-    float*   vec;
-    int sizeX, sizeY, sizeZ;
+    float   vec[8];
 
 public:
-    Cube2( float* val ) {
-        vec = val;
+    Cube2( const float val[8] ) {
+        memcpy( vec, val, 8*sizeof(float) );
     };
 
-	void setGridSize( int x, int y, int z ) {
-		sizeX = x;
-		sizeY = y;
-		sizeZ = z;
-	}
-
     float getVec( int i )
     {
-		int offset = 0;
-		if( i & 0x01 )
-			offset ++;
-		if( i & 0x02 )
-			offset += sizeX;
-		if( i & 0x04 )
-			offset += sizeX * sizeY;
-
-		return vec[offset];
+		return vec[i];
     }
 
     // 'empty' means that entire cube is on the one side of the surface
@@ -85,26 +74,26 @@ public:
 		if( v0 * v001 < 0.0f )
 			return true;
 
-    	float v010 = vec[sizeX];
+    	float v010 = vec[2];
 		if( v0 * v010 < 0.0f )
 			return true;
 
-    	float v100 = vec[sizeX*sizeY];
+    	float v100 = vec[4];
 		if( v0 * v100 < 0.0f )
 			return true;
 
 
-    	float v111 = vec[sizeX*sizeY+sizeX+1];
+    	float v111 = vec[7];
 
-    	float v011 = vec[sizeX+1];
+    	float v011 = vec[3];
 		if( v111 * v011 < 0.0f )
 			return true;
 
-    	float v101 = vec[sizeX*sizeY+1];
+    	float v101 = vec[5];
 		if( v111 * v101 < 0.0f )
 			return true;
 
-    	float v110 = vec[sizeX*sizeY+sizeX];
+    	float v110 = vec[6];
 		if( v111 * v110 < 0.0f )
 			return true;
 
@@ -113,9 +102,119 @@ public:
 };
 
 class VoxelField   {
-    // pointer to values data
+public:
+    // How samples are stored
+    enum Layout {
+		LAYOUT_LINEAR,		// planeSize*z + sizeX*y + x
+		LAYOUT_BRICKED,		// BRICK_SIZE^3 samples stored together, bricks in Morton order
+		LAYOUT_PAGED,		// the same bricks in a file, only some of them are in memory, see setPaging
+		LAYOUT_SPARSE		// the same bricks, allocated only when their samples differ, see pruneSparse
+    };
+
+private:
+    // pointer to values data, NULL in the paged and sparse layouts
+    //		points into mappedBase when the field was opened with openRaw
     float*      field;
 
+    Layout      layout;
+
+    // number of floats of the field, bricks on the far sides are padded to BRICK_SIZE^3, 0 if there's no field
+    //		the sparse layout counts all bricks, allocated or not
+    size_t      storageSize;
+
+    // bricked, paged and sparse layout - the (x,y,z) sample is in brick brickOrder[ mortonX[x>>BRICK_SHIFT] | mortonY[..] | mortonZ[..] ]
+    //		mortonX/Y/Z spread bits of brick coordinates, so OR-ing them gives a Morton code
+    //		brickOrder maps Morton codes to numbers of bricks stored one after another, codes outside of the field are never used
+    vector<int>	mortonX;
+    vector<int>	mortonY;
+    vector<int>	mortonZ;
+    vector<int>	brickOrder;
+    int         brickCount;
+
+    // sets the size and brick numbers, all bricks are dirty
+    void		_setDimensions( int x, int y, int z );
+    // allocates storage for the current size and layout, values are undefined
+    void		_storageAlloc();
+    void		_storageFree();
+
+    // raw volume file mapped by openRaw, see VoxelFieldFile.cpp
+    char*       mappedBase;
+    size_t      mappedSize;
+    void		_unmapFile();
+
+    size_t		_sampleOffset( int x, int y, int z ) {
+		if( layout == LAYOUT_LINEAR )
+			return (size_t)planeSize*z + sizeX*y + x;
+		return ((size_t)brickOrder[ mortonX[x >> BRICK_SHIFT] | mortonY[y >> BRICK_SHIFT] | mortonZ[z >> BRICK_SHIFT] ] << (3*BRICK_SHIFT)) +
+				((z & (BRICK_SIZE-1)) << (2*BRICK_SHIFT)) + ((y & (BRICK_SIZE-1)) << BRICK_SHIFT) + (x & (BRICK_SIZE-1));
+    }
+    float		_load( size_t offset ) {
+		if( field )
+			return field[offset];
+		return layout == LAYOUT_SPARSE ? _sparseLoad( offset ) : _pageLoad( offset );
+    }
+    void		_store( size_t offset, float val ) {
+		if( field )
+			field[offset] = val;
+		else if( layout == LAYOUT_SPARSE )
+			_sparseStore( offset, val );
+		else
+			_pageStore( offset, val );
+    }
+    // copies samples x0 <= x <= x1 of the (y,z) row of a bricked, paged or sparse field to buffer[x0..x1]
+    void		_gatherRow( int y, int z, int x0, int x1, float* buffer );
+
+    // paged layout, see VoxelFieldPaged.cpp
+    //		at most pageSlots.size() bricks are in memory, they form a list from the most to the least recently used one
+    //		a brick which doesn't fit replaces the last one, which is written back to the file if it was modified
+    struct PageSlot {
+		int		brick;			// -1 if the slot is free
+		bool	modified;
+		int		prev, next;
+    };
+    FILE*       pageFile;
+    string      pagePath;		// empty for a temporary file
+    size_t      pageBudget;
+    vector<float>		pageData;
+    vector<PageSlot>	pageSlots;
+    vector<int>			brickSlot;		// slot of every brick, -1 if it's only in the file
+    int         pageFirst, pageLast;
+    long long   pageLoads, pageWrites;
+    // set when a brick couldn't be written to the file, an evicted brick is lost then, see getPageError
+    bool        pageError;
+    // paged bricks are shared by all threads reading the field
+    mutex       pageMutex;
+
+    void		_pageAlloc();
+    void		_pageClose();
+    // makes the brick resident and the most recently used one, it's read from the file if 'load' is set
+    float*		_pageIn( int brick, bool load );
+    // returns false and sets pageError when the brick isn't written whole
+    bool		_pageWrite( int slot );
+    float		_pageLoad( size_t offset );
+    void		_pageStore( size_t offset, float val );
+
+    // sparse layout, see VoxelFieldSparse.cpp
+    //		sparseSlot is the place of every brick in sparseBricks, or -1 if the brick isn't allocated
+    //		and all its samples are sparseTile[brick]
+    vector<int>		sparseSlot;
+    vector<float>	sparseTile;
+    vector<float>	sparseBricks;
+    vector<int>		sparseFree;			// slots of sparseBricks released by pruneSparse
+    float			sparseBackground;
+
+    void		_sparseAlloc();
+    float		_sparseLoad( size_t offset ) {
+		size_t brick = offset >> (3*BRICK_SHIFT);
+		int slot = sparseSlot[brick];
+		if( slot < 0 )
+			return sparseTile[brick];
+		return sparseBricks[ ((size_t)slot << (3*BRICK_SHIFT)) + (offset & ((1 << (3*BRICK_SHIFT)) - 1)) ];
+    }
+    void		_sparseStore( size_t offset, float val );
+    // brick index ranges of bricks using only unallocated samples come from their tile values
+    void		_sparseRebuildIndex();
+
     // number of elements along each axis
     int         sizeX, sizeY, sizeZ;
 
@@ -125,6 +224,33 @@ class VoxelField   {
     // it's not really used ATM
     float       extentX, extentY, extentZ;
 
+    // optional min/max index of BRICK_SIZE^3 cubes, NULL if disabled
+    //		a brick stores range of all samples its cubes use, so samples on brick borders belong to 2 bricks
+    //		setVal only widens the range, so it's conservative until rebuildBrickIndex()
+    float*      brickMin;
+    float*      brickMax;
+
+    // number of bricks along each axis, bricks are also used by dirty tracking, so they're set even without the index
+    int         brickNumX, brickNumY, brickNumZ;
+
+    // bricks with cubes whose geometry may have changed since clearDirty, one byte per brick
+    //		when allDirty is set the whole field changed and single bricks aren't marked at all
+    vector<unsigned char>	dirty;
+    bool        allDirty;
+
+    // marks bricks of all cubes which may get different triangles or vertex normals when the (x,y,z) sample changes:
+    //		cubes using the sample and cubes sharing edges with them
+    void		_markDirty( int x, int y, int z );
+
+    // set by setBrickIndex, the index is recreated by setSize
+    bool        brickIndexEnabled;
+
+    void		_brickIndexAlloc();
+    // sets all brick ranges to empty, they will be widened by following setVal calls
+    void		_brickIndexClear();
+    // widens ranges of all bricks using the (x,y,z) sample
+    void		_brickIndexUpdate( int x, int y, int z, float val );
+
 	inline double	findnoise2(double x,double y)
 	{
 		int n=(int)x+(int)y*57;
@@ -150,10 +276,92 @@ public:
 
     bool _outsideOf( int val, int min, int max );
     bool setVal( int x, int y, int z, float val );
-    void getVal( int x, int y, int z, float* val );
+    // parameter checks are left out for performance, gradient normals read a dozen samples per vertex
+    void getVal( int x, int y, int z, float* val ) {
+		*val = _load( _sampleOffset( x,y,z ) );
+    }
 
     void    setAllValues( float val );
 
+    // bricks are BRICK_SIZE cubes long in each direction
+    static const int BRICK_SHIFT = 3;
+    static const int BRICK_SIZE = 1 << BRICK_SHIFT;
+
+    // enables min/max brick index used to skip empty regions during extraction
+    void    setBrickIndex( bool enable );
+    bool    hasBrickIndex() { return brickMin != NULL; }
+    // computes exact ranges of all bricks
+    void    rebuildBrickIndex();
+
+    int     getBrickNumX() { return brickNumX; }
+    int     getBrickNumY() { return brickNumY; }
+    int     getBrickNumZ() { return brickNumZ; }
+
+    // dirty bricks, setVal marks bricks of cubes whose geometry depends on the sample
+    //		setSize, setAllValues and the generators overwriting the whole field mark the whole field
+    bool    isBrickDirty( int bx, int by, int bz ) { return allDirty || dirty[ (bz*brickNumY + by)*brickNumX + bx ]; }
+    bool    isAllDirty() { return allDirty; }
+    void    markAllDirty() { allDirty = true; }
+    void    clearDirty();
+
+    // range of values used by cubes of the brick
+    float   getBrickMin( int bx, int by, int bz ) { return brickMin[ (bz*brickNumY + by)*brickNumX + bx ]; }
+    float   getBrickMax( int bx, int by, int bz ) { return brickMax[ (bz*brickNumY + by)*brickNumX + bx ]; }
+
+    // selects the memory layout, values of the field are kept, LAYOUT_LINEAR by default
+    void    setLayout( Layout l );
+    Layout  getLayout() { return layout; }
+
+    // file and memory budget of LAYOUT_PAGED, it has to be called before the paged field is allocated
+    //		path NULL uses an anonymous temporary file, a named file is removed when the field is destroyed
+    //		the budget should hold at least two z layers of bricks, otherwise extraction has to read bricks again
+    //		returns false if the file can't be created
+    bool    setPaging( const char* path, size_t residentBytes );
+    // writes all modified resident bricks to the file
+    //		returns false if any brick, this time or when it was evicted before, couldn't be written
+    bool    flushPages();
+    // a brick couldn't be written since the field was allocated, a full disk or an I/O error
+    //		a brick which failed when it was evicted reads back what the file had before, later reads may be stale
+    bool    getPageError() { return pageError; }
+    // number of bricks read from the file and written back since the field was allocated
+    long long   getPageLoads() { return pageLoads; }
+    long long   getPageWrites() { return pageWrites; }
+
+    // raw volume files - a header with dimensions, sample type and extents followed by float samples in the linear layout
+    //		openRaw maps the file as the field without copying it, the layout becomes LAYOUT_LINEAR
+    //		setVal changes only the process' copy of touched pages, unless writeBack is set - then values are written to the file
+    //		returns false if the file can't be read or isn't a float volume, the field is unchanged then
+    bool    openRaw( const char* path, bool writeBack = false );
+    // writes the field in any layout, returns false on write errors
+    //		the file is written as path.tmp and renamed over path, so the field may be saved to the file it's mapped from,
+    //		the mapping keeps the old file then - a writeBack field writes into it until it's opened again
+    bool    saveRaw( const char* path );
+    bool    isMapped() { return mappedBase != NULL; }
+
+    // value of all samples of a new LAYOUT_SPARSE field, 0 by default
+    //		setVal allocates a brick only when it writes a value different from the one the brick has
+    void    setSparseBackground( float val ) { sparseBackground = val; }
+    // releases allocated bricks which can't be a part of the surface - all their samples and samples next to them
+    //		are on the same side of every kept isovalue, each of these bricks gets one value between its samples,
+    //		so meshes at those isovalues stay the same, the brick index is rebuilt, returns the number of released bricks
+    //		isoValues NULL keeps only the surface at 0, meshes at other isovalues may change
+    //		ring is the number of samples around the brick which have to be on the same side too, 1 keeps positions
+    //		and triangle normals, MarchingCubes::NORMAL_GRADIENT reads samples one further and needs 2
+    int     pruneSparse( const float* isoValues = NULL, int isoNum = 0, int ring = 1 );
+    // number of allocated bricks of the sparse layout and number of all bricks of a field in bricks
+    int     getSparseBrickCount() { return (int)(sparseBricks.size() >> (3*BRICK_SHIFT)) - (int)sparseFree.size(); }
+    int     getStoredBrickCount() { return layout == LAYOUT_LINEAR ? 0 : brickCount; }
+
+    // values x0 <= x <= x1 of the (y,z) row, the result is indexed by x
+    //		the linear layout returns the field itself, the bricked one copies values to buffer[x0..x1]
+    //		so the buffer has to hold sizeX floats
+    const float*    getRow( int y, int z, int x0, int x1, float* buffer ) {
+		if( layout == LAYOUT_LINEAR )
+			return field + (size_t)planeSize*z + sizeX*y;
+		_gatherRow( y, z, x0, x1, buffer );
+		return buffer;
+    }
+
     // this method gets proper values forming an (x,y,z) cube and returns it in a helper class
     Cube2    getCube( int x, int y, int z );
 
@@ -47,11 +47,7 @@ bool	shiftBtn = false;
 int		currentAxis = 0;
 int		debugAxes[3] = {0,0,0};
 
-const	int					MAX_TRIS = 4000;
-MarchingCubes::Vertex       verts[MAX_TRIS];
-MarchingCubes::TriangleI    trisI[MAX_TRIS];
-int		vertexNum = 0;
-int		triNum = 0;
+MarchingCubes::Mesh		mesh;
 int		activeTriangle = -1;
 
 int		GRID_SIZE_X = 20;
@@ -205,11 +201,11 @@ void drawDebugAxes()
 		glEnable(GL_POLYGON_OFFSET_FILL);
 		glPolygonOffset(-1,-1);
 
-		drawTrianglesIndexedWireframe( verts, trisI, triNum );
+		drawTrianglesIndexedWireframe( mesh.getVertices(), mesh.getTriangles(), mesh.getTriNum() );
 
 		glColor3f( 1.0f, 1.0f, 1.0f );
 		glLineWidth( 2.0f );
-		drawTrianglesIndexedNormals( verts, trisI, triNum );
+		drawTrianglesIndexedNormals( mesh.getVertices(), mesh.getTriangles(), mesh.getTriNum() );
 
 		glEnable(GL_POLYGON_OFFSET_FILL);
 		glPolygonOffset(1,1);
@@ -219,12 +215,7 @@ void drawDebugAxes()
 
 void updateGeometry()
 {
-	for( int i = 0; i < MAX_TRIS; i++ ) {
-		verts[i].norm.setValue( 0.0f, 0.0f, 0.0f );
-		verts[i].used = 0;
-	}
-
-	int triangleNum = march.fillInTrianglesIndexed( verts, MAX_TRIS, trisI, MAX_TRIS, vertexNum, triNum );
+	march.fillInTrianglesIndexed( mesh );
 }
 
 void drawTrianglesIndexed( MarchingCubes::Vertex* verts, MarchingCubes::TriangleI* trisI, int triNum )
@@ -398,15 +389,16 @@ void printTime()
 			int debugCubeIdx = -1;
 			{
 				Cube2 cube = cf.getCube( debugAxes[0], debugAxes[1], debugAxes[2] );
-				cube.setGridSize( cf.getSizeX(), cf.getSizeY(), cf.getSizeZ() );
 
 				march.setValues( cube );
-				MarchingCubes::MarchingCubesCase &cubeCase = march.getCaseFromValues();
+				const MarchingCubes::MarchingCubesCase &cubeCase = march.getCaseFromValues();
 				debugCubeIdx = cubeCase.index;
 			}
+     MarchingCubes::TriangleI activeTri = { { -1, -1, -1 } };
+     if( activeTriangle >= 0 && activeTriangle < mesh.getTriNum() )
+		activeTri = mesh.getTriangles()[activeTriangle];
      sprintf( buff, "actTri:%d, i0:%d, i1:%d, i2:%d,  case:%d",
-					activeTriangle, trisI[activeTriangle].i[0],
-					trisI[activeTriangle].i[1], trisI[activeTriangle].i[2], debugCubeIdx );
+					activeTriangle, activeTri.i[0], activeTri.i[1], activeTri.i[2], debugCubeIdx );
      printText( -1, -0.7, buff );
 }
 
@@ -421,7 +413,7 @@ void drawFrame()
 	setupLightParams();
 	setupLight( lighting );
 
-	drawTrianglesIndexed( verts, trisI, triNum );
+	drawTrianglesIndexed( mesh.getVertices(), mesh.getTriangles(), mesh.getTriNum() );
 
 	setupLight( false );
 	drawAxes();
@@ -448,7 +440,7 @@ void printUsageStats()
         printf( "%d ", usageI );
 
         if( i != 0 && i != 255 ) {
-            MarchingCubes::MarchingCubesCase& cubeCase = march.getCase(i);
+            const MarchingCubes::MarchingCubesCase& cubeCase = march.getCase(i);
             if( cubeCase.numTri > 0 )
                 casesOk += usageI;
             else
@@ -535,6 +527,7 @@ int WINAPI WinMain(HINSTANCE hInstance,
 
 
 	march.init();
+	march.printTable();
 	cf.setSize( GRID_SIZE_X, GRID_SIZE_Y, GRID_SIZE_Z );
 
 	while (!bQuit)
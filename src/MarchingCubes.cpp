@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "MarchingCubes.h"
+#include "MarchingCubesTable.h"
 
 //	tools
 bool MarchingCubes::_differentSign( int a, int b )
@@ -64,19 +65,177 @@ int MarchingCubes::_planeToSign( int plane )
 }
 
 
-MarchingCubes::MarchingCubes( VoxelField& f ) : field(f)
+MarchingCubes::MarchingCubes( VoxelField& f ) : field(&f)
 {
     memset( usageStats, 0, sizeof(usageStats) );
+
+    table = &getSharedTable();
+    genTable = NULL;
+    _fillCacheSlots();
+
+    cacheField = NULL;
+    cacheGen = 0;
+    cacheGenEnd = 0;
+    cacheRowStride = cachePlaneStride = 0;
+    cacheSizeX = cacheSizeY = cacheSizeZ = 0;
+    cacheSize = 0;
+    cacheMode = CACHE_ROLLING;
+    normalMode = NORMAL_TRIANGLES;
+    isoValue = 0.0f;
+    truncated = false;
+    countThreadNum = 1;
+    countField = NULL;
+    countSize[0] = countSize[1] = countSize[2] = 0;
+    countIsoValue = 0.0f;
+    traversalMode = TRAVERSAL_ROWS;
+    traversalTile = 16;
+    tileNumX = tileNumY = 0;
+
+    outPos = outNorm = NULL;
+    outVertStride = 0;
+    outTris = NULL;
+    outMaxVert = outMaxTris = 0;
+    outVertBase = outTriBase = 0;
+    outMesh = NULL;
+    outMeshSoA = NULL;
+}
+
+MarchingCubes::MarchingCubes( const MarchingCubes& master ) : MarchingCubes( master, *master.field )
+{
+}
+
+MarchingCubes::MarchingCubes( const MarchingCubes& master, VoxelField& f ) : field(&f)
+{
+    memset( usageStats, 0, sizeof(usageStats) );
+
+    table = master.table;
+    genTable = NULL;
+    memcpy( edgeToCacheSlot, master.edgeToCacheSlot, sizeof(edgeToCacheSlot) );
+    memcpy( planeToCacheSlot, master.planeToCacheSlot, sizeof(planeToCacheSlot) );
+
+    cacheField = NULL;
+    cacheGen = 0;
+    cacheGenEnd = 0;
+    cacheRowStride = cachePlaneStride = 0;
+    cacheSizeX = cacheSizeY = cacheSizeZ = 0;
+    cacheSize = 0;
+    cacheMode = master.cacheMode;
+    normalMode = master.normalMode;
+    isoValue = master.isoValue;
+    truncated = false;
+    countThreadNum = 1;
+    countField = NULL;
+    countSize[0] = countSize[1] = countSize[2] = 0;
+    countIsoValue = 0.0f;
+    traversalMode = master.traversalMode;
+    traversalTile = master.traversalTile;
+    tileNumX = tileNumY = 0;
+
+    outPos = outNorm = NULL;
+    outVertStride = 0;
+    outTris = NULL;
+    outMaxVert = outMaxTris = 0;
+    outVertBase = outTriBase = 0;
+    outMesh = NULL;
+    outMeshSoA = NULL;
+}
+
+MarchingCubes::~MarchingCubes()
+{
+    _cacheFree();
+    for( size_t t = 0; t < batchWorkers.size(); t++ )
+        delete batchWorkers[t];
+}
+
+// all 256 cases analyzed by the compiler
+static constexpr MarchingCubes::Table bakedTable;
+
+static constexpr int countTriangles( const MarchingCubes::Table& table )
+{
+	int triCount = 0;
+	for( int i = 0; i < 256; i++ )
+		triCount += table.triangleTable[i].numTri;
+	return triCount;
+}
+
+// the same numbers as printTable() shows for the runtime table
+static_assert( bakedTable.triangleTable[1].numTri == 1 && bakedTable.triangleTable[254].numTri == 1,
+				"single corner cases should have one triangle" );
+static_assert( countTriangles( bakedTable ) == 740, "unexpected triangle count" );
+
+static constexpr MarchingCubes::CaseTable bakeCaseTable( const MarchingCubes::Table& baked )
+{
+	MarchingCubes::CaseTable cases{};
+	for( int v = 0; v < 8; v++ )
+		cases.vertexOffset[v] = baked.vertexOffset[v];
+	for( int e = 0; e < 12; e++ )
+	for( int i = 0; i < 2; i++ )
+		cases.edgeToVertex[e][i] = baked.edgeToVertex[e][i];
+	for( int plane = 0; plane < 6; plane++ )
+	for( int i = 0; i < 4; i++ ) {
+		cases.planeToVertex[plane][i] = baked.planeToVertex[plane][i];
+		cases.planeToEdge[plane][i] = baked.planeToEdge[plane][i];
+	}
+	for( int code = 0; code < 256; code++ )
+		cases.triangleTable[code] = baked.triangleTable[code];
+
+	cases.fillEdgeMasks();
+	return cases;
+}
+
+// read only data of the program, nothing writes it after the compiler
+static constexpr MarchingCubes::CaseTable sharedTable = bakeCaseTable( bakedTable );
+
+const MarchingCubes::CaseTable& MarchingCubes::getSharedTable()
+{
+	return sharedTable;
 }
 
 void MarchingCubes::init()
 {
+    table = &sharedTable;
+}
+
+bool MarchingCubes::checkTable()
+{
+    // generateTriangles() relies on an empty table
+    CaseTable* generated = new CaseTable();
+    genTable = generated;
+    table = generated;
+
     _fillVertices();
     _fillEdges();
     _fillPlanes();
     generateTriangles();
+    generated->fillEdgeMasks();
 
-    printTable();
+    bool res = !memcmp( generated->vertexOffset, sharedTable.vertexOffset, sizeof(sharedTable.vertexOffset) ) &&
+				!memcmp( generated->edgeToVertex, sharedTable.edgeToVertex, sizeof(sharedTable.edgeToVertex) ) &&
+				!memcmp( generated->planeToVertex, sharedTable.planeToVertex, sizeof(sharedTable.planeToVertex) ) &&
+				!memcmp( generated->planeToEdge, sharedTable.planeToEdge, sizeof(sharedTable.planeToEdge) ) &&
+				!memcmp( generated->caseEdges, sharedTable.caseEdges, sizeof(sharedTable.caseEdges) ) &&
+				!memcmp( generated->planeEdges, sharedTable.planeEdges, sizeof(sharedTable.planeEdges) );
+
+    for( int i = 0; i < 256 && res; i++ )
+	{
+		const MarchingCubesCase& a = generated->triangleTable[i];
+		const MarchingCubesCase& b = sharedTable.triangleTable[i];
+
+		// compared field by field, the structure has padding
+		res = a.index == b.index &&
+				a.numTri == b.numTri &&
+				!memcmp( a.tris, b.tris, sizeof(a.tris) ) &&
+				!memcmp( a.normal, b.normal, sizeof(a.normal) ) &&
+				a.capPlanes == b.capPlanes &&
+				!memcmp( a.capPlanesTab, b.capPlanesTab, sizeof(a.capPlanesTab) );
+		if( !res )
+			printf( "checkTable: case %d differs\n", i );
+    }
+
+    genTable = NULL;
+    delete generated;
+    init();
+    return res;
 }
 
 
@@ -85,7 +244,7 @@ int MarchingCubes::_bitsToCode( float verts[8] )
     int res = 0;
     for( int counter = 0; counter < 8; counter++ )
 	{
-        if( verts[counter] >= 0 )
+        if( verts[counter] >= isoValue )
         {
             int i = 1 << counter;
             res |= i;
@@ -98,7 +257,7 @@ void MarchingCubes::printTable()
 {
     printf( "Vertex offset:\n" );
     for( int v = 0; v < 8; v++ ) {
-        float* vert = vertexOffset[v].f;
+        const float* vert = table->vertexOffset[v].f;
         printf( "i:%d", v );
 
         for( int comp = 0; comp < 3; comp++ )
@@ -108,7 +267,7 @@ void MarchingCubes::printTable()
     printf( "\n" );
     printf( "Edge vertex:\n" );
     for( int e = 0; e < 12; e++ ) {
-        int* edge = edgeToVertex[e];
+        const int* edge = table->edgeToVertex[e];
         printf( "i:%d edge: %d - %d\n", e, edge[0], edge[1] );
     }
 
@@ -118,14 +277,14 @@ void MarchingCubes::printTable()
     int triCount = 0;
     for( int i = 0; i < 256; i++ )
 	{
-        MarchingCubesCase& cubeCase = triangleTable[i];
+        const MarchingCubesCase& cubeCase = table->triangleTable[i];
 
         printf( "i:%d t:%d", i, cubeCase.numTri );
         if( cubeCase.numTri > 0 )
             rowCount++;
         for( int tri = 0; tri < cubeCase.numTri; tri++ ) {
             printf( " tri:(" );
-            int *v = cubeCase.tris[tri].i;
+            const int *v = cubeCase.tris[tri].i;
             for( int tvert = 0; tvert < 3; tvert++ )
                 printf( "%d ", v[tvert] );
             printf( ")" );
@@ -152,8 +311,8 @@ void MarchingCubes::setValues( Cube2& cube )
 int MarchingCubes::_getEdgeAxis( int edge )
 {
     // Let's take both ends of an edge
-    int v1 = edgeToVertex[edge][0];
-    int v2 = edgeToVertex[edge][1];
+    int v1 = table->edgeToVertex[edge][0];
+    int v2 = table->edgeToVertex[edge][1];
     int diff = v1 ^ v2;     // We do XOR on both vertex indices so we get a bit, where they differ
     // simple if's to translate int value to bit number
     if( diff == 1 )
@@ -51,11 +51,11 @@ bool MarchingCubes::_vertexIsAtAxisSide( int v, int axis, int sign )
 int MarchingCubes::_findEdge( int v1, int v2 )
 {
     for( int edge = 0; edge < 12; edge++ ) {
-        if( v1 == edgeToVertex[edge][0] &&
-            v2 == edgeToVertex[edge][1] )
+        if( v1 == table->edgeToVertex[edge][0] &&
+            v2 == table->edgeToVertex[edge][1] )
            return edge;
-        if( v2 == edgeToVertex[edge][0] &&
-            v1 == edgeToVertex[edge][1] )
+        if( v2 == table->edgeToVertex[edge][0] &&
+            v1 == table->edgeToVertex[edge][1] )
            return edge;
     }
     return -1;
@@ -70,7 +70,7 @@ void MarchingCubes::_fillVertices()
 {
     for( int v = 0; v < 8; v++ ) {
         for( int compound = 0; compound < 3; compound++ )
-            vertexOffset[v].f[compound] = (v&(1<<compound)) ? 1.0f : 0.0f;
+            genTable->vertexOffset[v].f[compound] = (v&(1<<compound)) ? 1.0f : 0.0f;
     }
 }
 
@@ -80,8 +80,8 @@ void MarchingCubes::_fillEdges()
     for( int v1 = 0; v1 < 7; v1++ ){
         for( int v2 = v1+1; v2 < 8; v2++ ){
             if( _oneBitDiff(v1,v2) ) {  //one bit difference
-                edgeToVertex[edgesNum][0] = v1;
-                edgeToVertex[edgesNum][1] = v2;
+                genTable->edgeToVertex[edgesNum][0] = v1;
+                genTable->edgeToVertex[edgesNum][1] = v2;
                 edgesNum++;
             }
         }
@@ -143,19 +143,19 @@ void MarchingCubes::_fillPlanes()
 
 			for( int edge = 0; edge < 12; edge++ )
 			{
-				int v1 = edgeToVertex[edge][0];
-				int v2 = edgeToVertex[edge][1];
+				int v1 = genTable->edgeToVertex[edge][0];
+				int v2 = genTable->edgeToVertex[edge][1];
 				if( _vertexIsAtAxisSide( v1, axis, sign )
 					&& _vertexIsAtAxisSide( v2, axis, sign ) )
-							planeToEdge[plane][edgeCounter++] = edge;
+							genTable->planeToEdge[plane][edgeCounter++] = edge;
 			}
 			assert( edgeCounter == 4 );
 
-			_fixPlaneEdgesNormal( plane, planeToEdge[plane] );
+			_fixPlaneEdgesNormal( plane, genTable->planeToEdge[plane] );
 
 			for( int vert = 0; vert < 8; vert++ ) {
 				if( _vertexIsAtAxisSide( vert, axis, sign ) )
-					planeToVertex[plane][vertexCounter++] = vert;
+					genTable->planeToVertex[plane][vertexCounter++] = vert;
 			}
 			assert( vertexCounter == 4 );
 		}
@@ -165,17 +165,17 @@ void MarchingCubes::_fillPlanes()
 
 MarchingCubes::Vector3F MarchingCubes::getHalfEdge( int edgeNum )
 {
-    int v1 = edgeToVertex[edgeNum][0];
-    int v2 = edgeToVertex[edgeNum][1];
+    int v1 = genTable->edgeToVertex[edgeNum][0];
+    int v2 = genTable->edgeToVertex[edgeNum][1];
 
     Vector3F result;
 
-    float v1x = vertexOffset[v1].f[0];
-    float v1y = vertexOffset[v1].f[1];
-    float v1z = vertexOffset[v1].f[2];
-    float v2x = vertexOffset[v2].f[0];
-    float v2y = vertexOffset[v2].f[1];
-    float v2z = vertexOffset[v2].f[2];
+    float v1x = genTable->vertexOffset[v1].f[0];
+    float v1y = genTable->vertexOffset[v1].f[1];
+    float v1z = genTable->vertexOffset[v1].f[2];
+    float v2x = genTable->vertexOffset[v2].f[0];
+    float v2y = genTable->vertexOffset[v2].f[1];
+    float v2z = genTable->vertexOffset[v2].f[2];
 
     result.f[0] = (v1x+v2x) / 2;
     result.f[1] = (v1y+v2y) / 2;
@@ -196,8 +196,8 @@ void MarchingCubes::_getEdgesAlongAxis( int axis, int edges[4] )
 					if( b10 != b2 ) {
 						int x = 5;
 					}*/
-        if( _vertexIsNegByAxis(edgeToVertex[edge][0],axis) !=
-            _vertexIsNegByAxis(edgeToVertex[edge][1],axis) )
+        if( _vertexIsNegByAxis(genTable->edgeToVertex[edge][0],axis) !=
+            _vertexIsNegByAxis(genTable->edgeToVertex[edge][1],axis) )
             edges[counter++] = edge;
 	}
 	assert( counter == 4 );
@@ -211,8 +211,8 @@ int MarchingCubes::_getVertexBySymmetry( int vertex, int axis )
 
 int MarchingCubes::_getEdgeBySymmetry( int edge, int axis )
 {
-    int v1 = edgeToVertex[edge][0];
-    int v2 = edgeToVertex[edge][1];
+    int v1 = table->edgeToVertex[edge][0];
+    int v2 = table->edgeToVertex[edge][1];
     int v1Reflected = _getVertexBySymmetry( v1, axis );
     int v2Reflected = _getVertexBySymmetry( v2, axis );
 
@@ -275,14 +275,14 @@ MarchingCubes::Vector3F MarchingCubes::_getNormalFromBits( int bits )
 
 int MarchingCubes::generateTriangles()
 {
-    triangleTable[0].index = triangleTable[0].numTri = 0;
-    triangleTable[255].index = 255;
-    triangleTable[255].numTri = 0;
+    genTable->triangleTable[0].index = genTable->triangleTable[0].numTri = 0;
+    genTable->triangleTable[255].index = 255;
+    genTable->triangleTable[255].numTri = 0;
 
     for( int i = 1; i < 255; i++ ) {
-        if( triangleTable[i].index < 1 )
+        if( genTable->triangleTable[i].index < 1 )
 		{
-            triangleTable[i].index = i;
+            genTable->triangleTable[i].index = i;
 
             int tris = 0;
             tris += _findSingleVertexTriangles( i );
@@ -320,7 +320,7 @@ int MarchingCubes::_findSingleVertexTriangles( int code )
             signTab[vRefl[1]] < 0 &&
             signTab[vRefl[2]] < 0 )
 		{
-			MarchingCubesCase& cubeCase = triangleTable[code];
+			MarchingCubesCase& cubeCase = genTable->triangleTable[code];
 			cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( 7-v );
 			cubeCase.tris[ cubeCase.numTri ][0] = _findEdge( v, vRefl[0] );
 			cubeCase.tris[ cubeCase.numTri ][1] = _findEdge( v, vRefl[1] );
@@ -349,7 +349,7 @@ int MarchingCubes::_findSingleVertexTriangles( int code )
 				;
 			else
 			{
-				MarchingCubesCase& cubeCase = triangleTable[code];
+				MarchingCubesCase& cubeCase = genTable->triangleTable[code];
 				cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( v );
 				cubeCase.tris[ cubeCase.numTri ][0] = _findEdge( v, vRefl[0] );
 				cubeCase.tris[ cubeCase.numTri ][1] = _findEdge( v, vRefl[1] );
@@ -375,8 +375,8 @@ int MarchingCubes::_findEdgeTriangles( int code )
     for( int e = 0; e < 12; e++ )
 	{
         bool failed = false;
-        int v1 = edgeToVertex[e][0];
-        int v2 = edgeToVertex[e][1];
+        int v1 = genTable->edgeToVertex[e][0];
+        int v2 = genTable->edgeToVertex[e][1];
         int edgeAxis = _getEdgeAxis(e);
 
         if( signTab[v1] != signTab[v2] )
@@ -395,7 +395,7 @@ int MarchingCubes::_findEdgeTriangles( int code )
             }
         }
         if( !failed ) {
-            MarchingCubesCase& cubeCase = triangleTable[code];
+            MarchingCubesCase& cubeCase = genTable->triangleTable[code];
             if( signTab[v1] < 0 )
                 cubeCase.normal[cubeCase.numTri] = _getNormalFromBits(v1);
             else
@@ -474,7 +474,7 @@ int MarchingCubes::_findHalfSplit( int code )
             int edge2       = _getEdgeBySymmetry( startEdge, (axis+2)%3 );
             int endEdge     = _getEdgeBySymmetry( edge2, (axis+1)%3 );
 
-            MarchingCubesCase& cubeCase = triangleTable[code];
+            MarchingCubesCase& cubeCase = genTable->triangleTable[code];
 //            cubeCase.normal = _getNormalFromBits( 0 );
             cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( 0 );
             cubeCase.tris[ cubeCase.numTri ][0] = startEdge;
@@ -500,7 +500,7 @@ int MarchingCubes::_findHalfSplit( int code )
             int edge2       = _getEdgeBySymmetry( startEdge, (axis+2)%3 );
             int endEdge     = _getEdgeBySymmetry( edge2, (axis+1)%3 );
 
-            MarchingCubesCase& cubeCase = triangleTable[code];
+            MarchingCubesCase& cubeCase = genTable->triangleTable[code];
             cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( 7 );
             cubeCase.tris[ cubeCase.numTri ][0] = startEdge;
             cubeCase.tris[ cubeCase.numTri ][1] = edge1;
@@ -549,7 +549,7 @@ int MarchingCubes::_findTripleVertex( int code )
                 signTab[vRefl2A] > 0 &&
                 signTab[vRefl12] > 0 )
             {
-                MarchingCubesCase& cubeCase = triangleTable[code];
+                MarchingCubesCase& cubeCase = genTable->triangleTable[code];
                 cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( v );
                 cubeCase.tris[ cubeCase.numTri ][0] = _findEdge(vRefl2, vRefl2A);
                 cubeCase.tris[ cubeCase.numTri ][1] = _findEdge(vRefl1, vRefl1A);
@@ -579,7 +579,7 @@ int MarchingCubes::_findTripleVertex( int code )
                     signTab[vRefl2A] < 0 &&
                     signTab[vRefl12] < 0 )
             {
-                MarchingCubesCase& cubeCase = triangleTable[code];
+                MarchingCubesCase& cubeCase = genTable->triangleTable[code];
                 cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( 7-v );
                 cubeCase.tris[ cubeCase.numTri ][0] = _findEdge(vRefl2, vRefl2A);
                 cubeCase.tris[ cubeCase.numTri ][1] = _findEdge(vRefl1, vRefl12);
@@ -632,7 +632,7 @@ int MarchingCubes::_findFourVertex( int code )
             signTab[vRefl23] > 0 &&
             signTab[vRefl123] > 0 )
         {
-            MarchingCubesCase& cubeCase = triangleTable[code];
+            MarchingCubesCase& cubeCase = genTable->triangleTable[code];
             cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( v );
             cubeCase.tris[ cubeCase.numTri ][0] = _findEdge(vRefl1, vRefl13);
             cubeCase.tris[ cubeCase.numTri ][1] = _findEdge(vRefl1, vRefl12);
@@ -707,7 +707,7 @@ int MarchingCubes::_findSnake( int code )
                     int vRefl_13 = _getVertexBySymmetry( vRefl_1, ax3 );
                     int vRefl_23 = _getVertexBySymmetry( vRefl_2, ax3 );
 
-                    MarchingCubesCase& cubeCase = triangleTable[code];
+                    MarchingCubesCase& cubeCase = genTable->triangleTable[code];
 
                     cubeCase.normal[cubeCase.numTri] = _getNormalFromBits( vRefl_1 );
                     cubeCase.tris[ cubeCase.numTri ][0] = _findEdge(v, vRefl_3);
@@ -759,13 +759,13 @@ int MarchingCubes::_selectCapPlanes( int code )
 		{
 			int plane = _planeFromAxisSign( axis, sign );
 
-			triangleTable[code].capPlanesTab[plane] = 0;
+			genTable->triangleTable[code].capPlanesTab[plane] = 0;
 
-			int* planeEdges = planeToEdge[plane];
+			int* planeEdges = genTable->planeToEdge[plane];
 
 //			bool side = false;
 			std::set<int> edgesSet;
-			MarchingCubesCase& cubeCase = triangleTable[code];
+			MarchingCubesCase& cubeCase = genTable->triangleTable[code];
 
 			int triangleOnPlaneCount = 0;
 			// for each triangle
@@ -821,7 +821,7 @@ int MarchingCubes::_selectCapPlanes( int code )
 					if( sign == 0 )
 						planeSign = -planeSign;
 
-					triangleTable[code].capPlanesTab[plane] = planeSign;
+					genTable->triangleTable[code].capPlanesTab[plane] = planeSign;
 
 					break;
 				}
@@ -832,16 +832,17 @@ int MarchingCubes::_selectCapPlanes( int code )
 	// if any of the planes can be capped - set the main cap flag
 	// it will be easier during rendering to check one flag instead of 6
 	for( int i = 0; i < 6; i++ ) {
-		if( triangleTable[code].capPlanesTab[i] != 0 ) {
-			triangleTable[code].capPlanes = true;
+		if( genTable->triangleTable[code].capPlanesTab[i] != 0 ) {
+			genTable->triangleTable[code].capPlanes = true;
 			break;
 		}
 	}
+	return genTable->triangleTable[code].capPlanes;
 }
 
 int MarchingCubes::_fixTrianglesNormals( int code )
 {
-    MarchingCubesCase& cubeCase = triangleTable[code];
+    MarchingCubesCase& cubeCase = genTable->triangleTable[code];
     int counter = 0;
     for( int t = 0; t < cubeCase.numTri; t++ )
 	{
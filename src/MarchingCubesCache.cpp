@@ -8,117 +8,112 @@
 //#include <set>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include "MarchingCubes.h"
 
 
 // if there's no allocated vertex in given position - create one
-int MarchingCubes::_cacheVertex( MarchingCubes::Vertex* vert, int x, int y, int z, int e )
+int MarchingCubes::_cacheVertex( int x, int y, int z, int e )
 {
 	int res = -1;
 
-	int cache1 = _cacheOffsetFromCubeEdge( x,y,z, e );
-	if( cacheField[cache1] >= 0 ) {
-		res = cacheField[cache1];
-						vert[res].used++;
+	CacheEntry* cache1 = _cacheEntry( x,y,z, e );
+	if( cache1->vertex >= 0 ) {
+		res = cache1->vertex;
 	}
 	else {
 		// allocate new vertex in vertex table
-		cacheField[cache1] = currentVertex;
+		cache1->vertex = currentVertex;
 		Vector3F vertPos = getVertexFromEdge( e );
 		vertPos.f[0] += x;
 		vertPos.f[1] += y;
 		vertPos.f[2] += z;
-		vert[currentVertex].pos = vertPos;
-		vert[currentVertex].norm.setValue( 0.0f, 0.0f, 0.0f );
-		vert[currentVertex].used = 0;
+		_outPos( currentVertex ) = vertPos;
+		if( normalMode == NORMAL_GRADIENT )
+			_outNorm( currentVertex ) = _gradientNormal( vertPos );
+		else
+			_outNorm( currentVertex ).setValue( 0.0f, 0.0f, 0.0f );
 		res = currentVertex++;
 	}
 	return res;
 }
 
-int MarchingCubes::_cacheOffsetFromCubeEdge( int x, int y, int z, int e )
+void MarchingCubes::_fillCacheSlots()
 {
-//	printf( "---_cacheOffsetFromCubeEdge: x,y,z, e: %d,%d,%d, %d", x,y,z, e );
-	// if the edge has 'smaller' reflection, take the smaller one and move to the next cube
-    if( _getEdgeBySymmetry(e,0) < e ) {
-        x++;
-        e = _getEdgeBySymmetry(e,0);
-    }
-    if( _getEdgeBySymmetry(e,1) < e ) {
-        y++;
-        e = _getEdgeBySymmetry(e,1);
-    }
-    if( _getEdgeBySymmetry(e,2) < e ) {
-        z++;
-        e = _getEdgeBySymmetry(e,2);
-    }
-
-    int res = x + y * cacheSizeX + z*cacheSizeX*cacheSizeY;
-    res = (res * 4) + e;
-
-    return res;
-}
-
-int MarchingCubes::_cacheOffsetFromPlane( int x, int y, int z, int plane )
-{
-	int axis = _planeToAxis( plane );
-	int sign = _planeToSign( plane );
-
-	if( sign > 0 ) {
-		if( axis == 0 )
-			x++;
-		else if( axis == 1 )
-			y++;
-		else if( axis == 2 )
-			z++;
-		else
-			throw "_cacheOffsetFromPlane error!";
-
-		plane = _planeFromAxisSign( axis, 0 );
+	for( int e = 0; e < 12; e++ )
+	{
+		CacheSlot& s = edgeToCacheSlot[e];
+		int d[3] = { 0, 0, 0 };
+
+		// if the edge has 'smaller' reflection, take the smaller one and move to the next cube
+		int edge = e;
+		for( int axis = 0; axis < 3; axis++ ) {
+			if( _getEdgeBySymmetry(edge,axis) < edge ) {
+				d[axis] = 1;
+				edge = _getEdgeBySymmetry(edge,axis);
+			}
+		}
+		s.dx = d[0];
+		s.dy = d[1];
+		s.dz = d[2];
+		s.slot = edge;
+		s.offset = 0;
 	}
-//	int offset = _cacheOffsetFromCubeEdge( x, y, z, plane );
-/*	bool mirrored = false;
-	if( plane == 5 ) {
-		mirrored = true;
-		plane--;
-		z++;
-	}
-	else if( plane == 3 ) {
-		mirrored = true;
-		plane--;
-		y++;
+
+	for( int plane = 0; plane < 6; plane++ )
+	{
+		CacheSlot& s = planeToCacheSlot[plane];
+		int axis = _planeToAxis( plane );
+
+		// the plane on the positive side is the negative plane of the next cube
+		int next = _planeToSign( plane ) > 0 ? 1 : 0;
+		s.dx = axis == 0 ? next : 0;
+		s.dy = axis == 1 ? next : 0;
+		s.dz = axis == 2 ? next : 0;
+		s.slot = axis;
+		s.offset = 0;
 	}
-	else if( plane == 1 ) {
-		mirrored = true;
-		plane--;
-		x++;
-	}*/
-
-    int res = x + y * cacheSizeX + z*cacheSizeX*cacheSizeY;
-    res = (res * 6) + plane;
-    return res;
 }
 
-int* MarchingCubes::_cacheAlloc( int fieldX, int fieldY, int fieldZ )
+MarchingCubes::CacheEntry* MarchingCubes::_cacheAlloc( int fieldX, int fieldY, int fieldZ )
 {
-    _cacheFree();
+	int sizeZ;
+    if( cacheMode == CACHE_ROLLING )
+		// only the bottom and top plane of the current cube layer
+		sizeZ = 2;
+	else
+		// z is wrapped with a mask, so it's aligned to 2^n
+		sizeZ = 1 << _getBitNum( fieldZ );
+
+	// the same size as the last fill - old entries will be invalidated by _cacheClear
+	if( cacheField && cacheSizeX == fieldX && cacheSizeY == fieldY && cacheSizeZ == sizeZ )
+		return cacheField;
 
-	// get number of bits needed to store the x,y,z value
-    int x = _getBitNum( fieldX );
-    int y = _getBitNum( fieldY );
-    int z = _getBitNum( fieldZ );
-
-	// 2^numBits
-	// size of the field aligned to 2^n
-    cacheSizeX = 1 << (x);
-    cacheSizeY = 1 << (y);
-    cacheSizeZ = 1 << (z);
+    _cacheFree();
 
-	// for each of the x,y,z position we store 4 int's
-	// 		3 of them corresponds to 3 edges going forward from this position
-	//		4'th is not used, added just for alignment
-    cacheSize = cacheSizeX*cacheSizeY*cacheSizeZ * 4;
-    cacheField = new int[ cacheSize ];
+    cacheSizeX = fieldX;
+    cacheSizeY = fieldY;
+    cacheSizeZ = sizeZ;
+
+	// for each of the x,y,z position we store 3 entries
+	// 		they correspond to 3 edges going forward from this position
+	//		and 3 planes perpendicular to them
+    cacheSize = cacheSizeX*cacheSizeY*cacheSizeZ * 3;
+    cacheField = new CacheEntry[ cacheSize ];
+
+    cacheRowStride = cacheSizeX * 3;
+    cachePlaneStride = cacheSizeX*cacheSizeY * 3;
+	for( int e = 0; e < 12; e++ ) {
+		CacheSlot& s = edgeToCacheSlot[e];
+		s.offset = s.dx*3 + s.dy*cacheRowStride + s.slot;
+	}
+	for( int plane = 0; plane < 6; plane++ ) {
+		CacheSlot& s = planeToCacheSlot[plane];
+		s.offset = s.dx*3 + s.dy*cacheRowStride + s.slot;
+	}
+    memset( cacheField, 0, cacheSize * sizeof(CacheEntry) );
+    cacheGen = 0;
+    cacheGenEnd = 0;
 
     return cacheField;
 }
@@ -133,12 +128,21 @@ void MarchingCubes::_cacheFree()
 	cacheSizeY = 0;
 	cacheSizeZ = 0;
 	cacheSize = 0;
+	cacheGen = 0;
+	cacheGenEnd = 0;
 }
 
 void MarchingCubes::_cacheClear()
 {
-    if( cacheField ) {
-        for( int i = 0; i < cacheSize; i++ )
-            cacheField[i] = -1;
-    }
+	// every plane z of the field gets its own generation, planes up to sizeZ are stamped
+	unsigned int sizeZ = field->getSizeZ();
+
+	// stamps would wrap around - reset them all, it happens once in 4 billion planes
+	if( cacheGenEnd > UINT_MAX - 2*(sizeZ+1) ) {
+		memset( cacheField, 0, cacheSize * sizeof(CacheEntry) );
+		cacheGenEnd = 0;
+	}
+	// above all stamps of earlier fills, also of deeper fields, and above 0 of cleared entries
+	cacheGen = cacheGenEnd + 1;
+	cacheGenEnd = cacheGen + sizeZ;
 }
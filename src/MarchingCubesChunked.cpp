@@ -0,0 +1,122 @@
+/*
+    MarchingCubes - main class for all Marching Cubes computations
+    Author: Karol Herda
+    Web:    http://kolenda.me/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Incremental extraction - the field is meshed in chunks matching bricks of VoxelField,
+    and only chunks of bricks marked dirty by the field are generated again.
+
+    A chunk is generated together with one cube around it, in the usual z,y,x order:
+    - normals of vertices on chunk borders get triangles of neighbour chunks as well,
+    - cap planes on the chunk's lower sides pair with the cubes below, the chunk's cube is the second one and emits the cap,
+    - caps on its upper sides are emitted by the next chunk, the same way as in the single mesh.
+    Triangles are summed into normals in the same order as in fillInTrianglesIndexed, so the result is the same.
+*/
+
+#include "MarchingCubes.h"
+
+int MarchingCubes::updateChunkedMesh( ChunkedMesh& mesh )
+{
+	int numX = field->getBrickNumX();
+	int numY = field->getBrickNumY();
+	int numZ = field->getBrickNumZ();
+
+	bool all = field->isAllDirty();
+	if( numX != mesh.chunkNumX || numY != mesh.chunkNumY || numZ != mesh.chunkNumZ )
+	{
+		mesh.chunks.clear();
+		mesh.chunks.resize( numX * numY * numZ );
+		mesh.chunkNumX = numX;
+		mesh.chunkNumY = numY;
+		mesh.chunkNumZ = numZ;
+		all = true;
+	}
+
+	mesh.updated.clear();
+	if( field->getSizeX() < 2 || field->getSizeY() < 2 || field->getSizeZ() < 2 ) {
+		field->clearDirty();
+		return 0;
+	}
+
+	_cacheAlloc( field->getSizeX(), field->getSizeY(), field->getSizeZ() );
+
+	for( int cz = 0; cz < numZ; cz++ )
+	for( int cy = 0; cy < numY; cy++ )
+	for( int cx = 0; cx < numX; cx++ )
+	{
+		if( !all && !field->isBrickDirty( cx, cy, cz ) )
+			continue;
+
+		int index = (cz*numY + cy)*numX + cx;
+		_fillChunk( cx, cy, cz, mesh.chunks[index] );
+		mesh.updated.push_back( index );
+	}
+
+	field->clearDirty();
+	return (int)mesh.updated.size();
+}
+
+void MarchingCubes::_fillChunk( int cx, int cy, int cz, Mesh& chunk )
+{
+	int cubes[3] = { field->getSizeX()-1, field->getSizeY()-1, field->getSizeZ()-1 };
+	int pos[3] = { cx, cy, cz };
+
+	// own cubes lo <= c < hi, generated cubes from - to
+	int lo[3], hi[3], from[3], to[3];
+	for( int a = 0; a < 3; a++ ) {
+		lo[a] = pos[a] << VoxelField::BRICK_SHIFT;
+		hi[a] = min( lo[a] + VoxelField::BRICK_SIZE, cubes[a] );
+		from[a] = max( lo[a] - 1, 0 );
+		to[a] = min( hi[a] + 1, cubes[a] );
+	}
+
+	_cacheClear();
+	_setOutput( chunkScratch );
+
+	currentTriangle	= 0;
+	currentVertex	= 0;
+	truncated		= false;
+
+	chunkTris.clear();
+	for( int z = from[2]; z < to[2]; z++ )
+	for( int y = from[1]; y < to[1]; y++ )
+	{
+		if( z < lo[2] || z >= hi[2] || y < lo[1] || y >= hi[1] ) {
+			_marchRow( y,z, from[0], to[0] );
+			continue;
+		}
+
+		_marchRow( y,z, from[0], lo[0] );
+		chunkTris.push_back( currentTriangle );
+		_marchRow( y,z, lo[0], hi[0] );
+		chunkTris.push_back( currentTriangle );
+		_marchRow( y,z, hi[0], to[0] );
+	}
+
+	// no cube can use more vertices or triangles than all generated ones
+	chunk.clear();
+	chunk.reserve( currentVertex, currentTriangle );
+	chunkRemap.assign( currentVertex, -1 );
+
+	for( size_t r = 0; r < chunkTris.size(); r += 2 )
+	for( int t = chunkTris[r]; t < chunkTris[r+1]; t++ )
+	{
+		TriangleI& src = outTris[t];
+		TriangleI& dst = chunk.tris[ chunk.triNum++ ];
+		for( int i = 0; i < 3; i++ )
+		{
+			int v = src[i];
+			if( chunkRemap[v] < 0 )
+			{
+				Vertex& vert = chunk.vert[ chunk.vertexNum ];
+				vert.pos = _outPos( v );
+				vert.norm = _outNorm( v );
+				if( normalMode == NORMAL_TRIANGLES )
+					vert.norm.normalise();
+				chunkRemap[v] = chunk.vertexNum++;
+			}
+			dst[i] = chunkRemap[v];
+		}
+	}
+}
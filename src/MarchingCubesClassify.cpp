@@ -0,0 +1,198 @@
+/*
+    MarchingCubes - main class for all Marching Cubes computations
+    Author: Karol Herda
+    Web:    http://kolenda.me/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Row classification - computes case codes for a run of cubes along x at once.
+    Corners of the cubes come from 4 rows of the field: (y,z), (y+1,z), (y,z+1) and (y+1,z+1),
+    corner i of cube x is rows[i>>1][x + (i&1)], the same as corner bits used by _bitsToCode.
+    A corner is inside when its value is at least the isovalue, see setIsoValue.
+
+    SSE4.1 and AVX2 versions are selected at runtime, the scalar one works everywhere.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "MarchingCubes.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define MC_CLASSIFY_X86
+	#include <immintrin.h>
+#endif
+
+typedef void (*ClassifyRowFunc)( const float* rows[4], int count, float isoValue, unsigned char* codes );
+
+static void classifyRowScalar( const float* rows[4], int count, float isoValue, unsigned char* codes )
+{
+	for( int x = 0; x < count; x++ )
+	{
+		int code = 0;
+		for( int v = 0; v < 8; v++ ) {
+			if( rows[v>>1][x + (v&1)] >= isoValue )
+				code |= 1 << v;
+		}
+		codes[x] = (unsigned char)code;
+	}
+}
+
+#ifdef MC_CLASSIFY_X86
+
+__attribute__((target("sse4.1")))
+static void classifyRowSSE4( const float* rows[4], int count, float isoValue, unsigned char* codes )
+{
+	const __m128 iso = _mm_set1_ps( isoValue );
+
+	// 8 cubes per step, two vectors of 4 codes packed into bytes
+	int x = 0;
+	for( ; x + 8 <= count; x += 8 )
+	{
+		__m128i code[2];
+		for( int h = 0; h < 2; h++ )
+		{
+			__m128i c = _mm_setzero_si128();
+			for( int v = 0; v < 8; v++ ) {
+				__m128 val = _mm_loadu_ps( rows[v>>1] + x + 4*h + (v&1) );
+				__m128i inside = _mm_castps_si128( _mm_cmpge_ps( val, iso ) );
+				c = _mm_or_si128( c, _mm_and_si128( inside, _mm_set1_epi32( 1 << v ) ) );
+			}
+			code[h] = c;
+		}
+		__m128i code16 = _mm_packus_epi32( code[0], code[1] );
+		_mm_storel_epi64( (__m128i*)(codes + x), _mm_packus_epi16( code16, code16 ) );
+	}
+
+	const float* tail[4] = { rows[0] + x, rows[1] + x, rows[2] + x, rows[3] + x };
+	classifyRowScalar( tail, count - x, isoValue, codes + x );
+}
+
+__attribute__((target("avx2")))
+static void classifyRowAVX2( const float* rows[4], int count, float isoValue, unsigned char* codes )
+{
+	const __m256 iso = _mm256_set1_ps( isoValue );
+
+	// 8 cubes per step
+	int x = 0;
+	for( ; x + 8 <= count; x += 8 )
+	{
+		__m256i c = _mm256_setzero_si256();
+		for( int v = 0; v < 8; v++ ) {
+			__m256 val = _mm256_loadu_ps( rows[v>>1] + x + (v&1) );
+			__m256i inside = _mm256_castps_si256( _mm256_cmp_ps( val, iso, _CMP_GE_OQ ) );
+			c = _mm256_or_si256( c, _mm256_and_si256( inside, _mm256_set1_epi32( 1 << v ) ) );
+		}
+		__m128i code16 = _mm_packus_epi32( _mm256_castsi256_si128( c ), _mm256_extracti128_si256( c, 1 ) );
+		_mm_storel_epi64( (__m128i*)(codes + x), _mm_packus_epi16( code16, code16 ) );
+	}
+
+	const float* tail[4] = { rows[0] + x, rows[1] + x, rows[2] + x, rows[3] + x };
+	classifyRowScalar( tail, count - x, isoValue, codes + x );
+}
+
+#endif // MC_CLASSIFY_X86
+
+static bool classifyKernelSupported( MarchingCubes::ClassifyKernel kernel )
+{
+#ifdef MC_CLASSIFY_X86
+	// it's also used by static initialization below
+	__builtin_cpu_init();
+#endif
+	switch( kernel ) {
+		case MarchingCubes::CLASSIFY_SCALAR:
+			return true;
+#ifdef MC_CLASSIFY_X86
+		case MarchingCubes::CLASSIFY_SSE4:
+			return __builtin_cpu_supports( "sse4.1" );
+		case MarchingCubes::CLASSIFY_AVX2:
+			return __builtin_cpu_supports( "avx2" );
+#endif
+		default:
+			return false;
+	}
+}
+
+static MarchingCubes::ClassifyKernel bestClassifyKernel()
+{
+	if( classifyKernelSupported( MarchingCubes::CLASSIFY_AVX2 ) )
+		return MarchingCubes::CLASSIFY_AVX2;
+	if( classifyKernelSupported( MarchingCubes::CLASSIFY_SSE4 ) )
+		return MarchingCubes::CLASSIFY_SSE4;
+	return MarchingCubes::CLASSIFY_SCALAR;
+}
+
+static ClassifyRowFunc classifyFunc( MarchingCubes::ClassifyKernel kernel )
+{
+	switch( kernel ) {
+#ifdef MC_CLASSIFY_X86
+		case MarchingCubes::CLASSIFY_SSE4:
+			return classifyRowSSE4;
+		case MarchingCubes::CLASSIFY_AVX2:
+			return classifyRowAVX2;
+#endif
+		default:
+			return classifyRowScalar;
+	}
+}
+
+// selected once for the whole process, it depends only on the CPU
+static MarchingCubes::ClassifyKernel	currentKernel = bestClassifyKernel();
+static ClassifyRowFunc					classifyRow = classifyFunc( currentKernel );
+
+bool MarchingCubes::setClassifyKernel( ClassifyKernel kernel )
+{
+	if( kernel == CLASSIFY_AUTO )
+		kernel = bestClassifyKernel();
+	if( !classifyKernelSupported( kernel ) )
+		return false;
+
+	currentKernel = kernel;
+	classifyRow = classifyFunc( kernel );
+	return true;
+}
+
+MarchingCubes::ClassifyKernel MarchingCubes::getClassifyKernel()
+{
+	return currentKernel;
+}
+
+void MarchingCubes::_classifyRow( const float* rows[4], int x0, int x1, unsigned char* codes )
+{
+	const float* start[4] = { rows[0] + x0, rows[1] + x0, rows[2] + x0, rows[3] + x0 };
+	classifyRow( start, x1 - x0, isoValue, codes );
+}
+
+void MarchingCubes::_classifyLayer( int z, unsigned char* codes )
+{
+	int cubesX = field->getSizeX()-1;
+	int cubesY = field->getSizeY()-1;
+
+	bool bricks = field->hasBrickIndex();
+	int bz = z >> VoxelField::BRICK_SHIFT;
+
+	for( int y = 0; y < cubesY; y++, codes += cubesX )
+	{
+		const float* rows[4];
+		if( !bricks ) {
+			_getRows( y, z, 0, cubesX, rows );
+			_classifyRow( rows, 0, cubesX, codes );
+			continue;
+		}
+
+		int by = y >> VoxelField::BRICK_SHIFT;
+		for( int x = 0; x < cubesX; )
+		{
+			int bx = x >> VoxelField::BRICK_SHIFT;
+			int end = min( (bx+1) << VoxelField::BRICK_SHIFT, cubesX );
+
+			float brickMin = field->getBrickMin( bx, by, bz );
+			float brickMax = field->getBrickMax( bx, by, bz );
+			if( brickMax < isoValue || brickMin >= isoValue )
+				memset( codes + x, brickMax < isoValue ? 0 : 255, end - x );
+			else {
+				_getRows( y, z, x, end, rows );
+				_classifyRow( rows, x, end, codes + x );
+			}
+			x = end;
+		}
+	}
+}
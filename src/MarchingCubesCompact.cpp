@@ -0,0 +1,107 @@
+/*
+    MarchingCubes - main class for all Marching Cubes computations
+    Author: Karol Herda
+    Web:    http://kolenda.me/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Compact vertices - 16 bit fixed point positions and octahedral normals.
+    Normals are sums of triangle normals until no more cubes touch the vertex,
+    so the mesh is generated with streamTrianglesIndexed and quantized when vertices leave its window.
+*/
+
+#include "MarchingCubes.h"
+
+static float signNotZero( float f )
+{
+	return f >= 0.0f ? 1.0f : -1.0f;
+}
+
+static short toSnorm16( float f )
+{
+	f = min( max( f, -1.0f ), 1.0f );
+	return (short)lrintf( f * 32767.0f );
+}
+
+float MarchingCubes::getPositionScale( int fieldSize )
+{
+	return fieldSize > 1 ? 65535.0f / (fieldSize-1) : 1.0f;
+}
+
+void MarchingCubes::encodePosition( const Vector3F& pos, float scale, CompactVertex& v )
+{
+	for( int i = 0; i < 3; i++ ) {
+		float q = pos.f[i] * scale + 0.5f;
+		v.pos[i] = (unsigned short)min( max( q, 0.0f ), 65535.0f );
+	}
+}
+
+MarchingCubes::Vector3F MarchingCubes::decodePosition( const CompactVertex& v, float scale )
+{
+	float inv = 1.0f / scale;
+	return Vector3F( v.pos[0] * inv, v.pos[1] * inv, v.pos[2] * inv );
+}
+
+void MarchingCubes::encodeNormal( const Vector3F& norm, CompactVertex& v )
+{
+	float len = fabsf( norm.f[0] ) + fabsf( norm.f[1] ) + fabsf( norm.f[2] );
+	// degenerate normals (all triangles of the vertex have zero area) are stored as +z
+	if( !(len > 0.0f) ) {
+		v.norm[0] = v.norm[1] = 0;
+		return;
+	}
+
+	float x = norm.f[0] / len;
+	float y = norm.f[1] / len;
+	if( norm.f[2] < 0.0f ) {
+		float fx = (1.0f - fabsf( y )) * signNotZero( x );
+		float fy = (1.0f - fabsf( x )) * signNotZero( y );
+		x = fx;
+		y = fy;
+	}
+	v.norm[0] = toSnorm16( x );
+	v.norm[1] = toSnorm16( y );
+}
+
+MarchingCubes::Vector3F MarchingCubes::decodeNormal( const CompactVertex& v )
+{
+	float x = max( v.norm[0] / 32767.0f, -1.0f );
+	float y = max( v.norm[1] / 32767.0f, -1.0f );
+	float z = 1.0f - fabsf( x ) - fabsf( y );
+	if( z < 0.0f ) {
+		float fx = (1.0f - fabsf( y )) * signNotZero( x );
+		float fy = (1.0f - fabsf( x )) * signNotZero( y );
+		x = fx;
+		y = fy;
+	}
+	Vector3F norm( x, y, z );
+	norm.normalise();
+	return norm;
+}
+
+// streamTrianglesIndexed sink appending to a CompactMesh
+struct CompactSink {
+	vector<MarchingCubes::CompactVertex>&	vert;
+	vector<MarchingCubes::TriangleI>&		tris;
+	float									scale;
+
+	void vertex( int, const MarchingCubes::Vector3F& pos, const MarchingCubes::Vector3F& norm ) {
+		MarchingCubes::CompactVertex v;
+		MarchingCubes::encodePosition( pos, scale, v );
+		MarchingCubes::encodeNormal( norm, v );
+		vert.push_back( v );
+	}
+	void triangle( const MarchingCubes::TriangleI& tri ) {
+		tris.push_back( tri );
+	}
+};
+
+int MarchingCubes::fillInTrianglesCompact( CompactMesh& mesh )
+{
+	int size = max( field->getSizeX(), max( field->getSizeY(), field->getSizeZ() ) );
+
+	mesh.clear();
+	mesh.posScale = getPositionScale( size );
+
+	CompactSink sink = { mesh.vert, mesh.tris, mesh.posScale };
+	return streamTrianglesIndexed( sink );
+}
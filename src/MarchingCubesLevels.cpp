@@ -0,0 +1,98 @@
+/*
+    MarchingCubes - main class for all Marching Cubes computations
+    Author: Karol Herda
+    Web:    http://kolenda.me/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Several isosurfaces of one field in a single pass - nested surfaces of scans or simulations are usually
+    looked at a few levels at a time. Every level is a worker object with its own isovalue, vertex cache and mesh,
+    while the master walks the field by rows and passes the same 4 field rows to all levels which may cross the brick.
+    Samples are gathered from bricks or pages once per row instead of once per level and stay in the CPU cache
+    while the levels classify them.
+*/
+
+#include "MarchingCubes.h"
+
+int MarchingCubes::fillInTrianglesLevels( const float* isoValues, int levelNum, Mesh* meshes )
+{
+	truncated = false;
+	if( levelNum <= 0 )
+		return 0;
+
+	vector<MarchingCubes*> levels( levelNum );
+	for( int l = 0; l < levelNum; l++ )
+	{
+		MarchingCubes* level = new MarchingCubes( *this );
+		level->isoValue = isoValues[l];
+		level->_setOutput( meshes[l] );
+		level->_cacheAlloc( field->getSizeX(), field->getSizeY(), field->getSizeZ() );
+		level->_cacheClear();
+		level->currentTriangle = 0;
+		level->currentVertex = 0;
+		levels[l] = level;
+	}
+
+	// rolling caches of the levels need z going outermost, the same as _fillField
+	for( int z = 0; z < field->getSizeZ()-1; z++ )
+	for( int y = 0; y < field->getSizeY()-1; y++ )
+		_marchRowLevels( y, z, &levels[0], levelNum );
+
+	int triNum = 0;
+	for( int l = 0; l < levelNum; l++ )
+	{
+		MarchingCubes* level = levels[l];
+		if( normalMode == NORMAL_TRIANGLES )
+			for( int v = 0; v < level->currentVertex; v++ )
+				level->_outNorm( v ).normalise();
+
+		meshes[l].vertexNum = level->currentVertex;
+		meshes[l].triNum = level->currentTriangle;
+		triNum += level->currentTriangle;
+		truncated |= level->truncated;
+
+		for( int i = 0; i < 256; i++ )
+			usageStats[i] += level->usageStats[i];
+		delete level;
+	}
+	return triNum;
+}
+
+void MarchingCubes::_marchRowLevels( int y, int z, MarchingCubes** levels, int levelNum )
+{
+	int cubesX = field->getSizeX()-1;
+
+	bool bricks = field->hasBrickIndex();
+	int by = y >> VoxelField::BRICK_SHIFT;
+	int bz = z >> VoxelField::BRICK_SHIFT;
+
+	const float* rows[4];
+	for( int x = 0; x < cubesX; )
+	{
+		int end = cubesX;
+		float brickMin = 0.0f;
+		float brickMax = 0.0f;
+		if( bricks ) {
+			int bx = x >> VoxelField::BRICK_SHIFT;
+			end = min( (bx+1) << VoxelField::BRICK_SHIFT, cubesX );
+			brickMin = field->getBrickMin( bx, by, bz );
+			brickMax = field->getBrickMax( bx, by, bz );
+		}
+
+		// a brick is skipped by the levels outside of its range, rows are loaded by the first one which needs them
+		bool loaded = false;
+		for( int l = 0; l < levelNum; l++ )
+		{
+			MarchingCubes* level = levels[l];
+			if( bricks && (brickMax < level->isoValue || brickMin >= level->isoValue) ) {
+				level->usageStats[ brickMax < level->isoValue ? 0 : 255 ] += end - x;
+				continue;
+			}
+			if( !loaded ) {
+				_getRows( y, z, x, end, rows );
+				loaded = true;
+			}
+			level->_marchSpan( rows, y, z, x, end );
+		}
+		x = end;
+	}
+}
@@ -0,0 +1,550 @@
+/*
+    MarchingCubes - main class for all Marching Cubes computations
+    Author: Karol Herda
+    Web:    http://kolenda.me/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Level of detail - every chunk of a LodMesh takes every 2^lod-th sample of the field into a small field of its own
+    and a worker object generates it there, positions are then moved back to field coordinates.
+
+    Chunks of different lods meet in two steps, in the spirit of Transvoxel transition cells:
+    - samples on chunk borders are taken from the coarsest chunk touching them - a sample between its samples
+      is interpolated from them (see _lodSample), so vertices on edges of the coarse grid are the same in all chunks,
+    - the coarse chunk's cube case cuts its face along its own segments, the finer chunk cuts it along polylines
+      through its extra samples, both through the same crossings. The finer chunk fills the flat gap between them
+      with fans (_stitchLodFace). Ambiguous faces are paired the way the coarse case pairs them, where one side has
+      a tunnel through the face the gap is the polygon of all crossings, like a cap plane. Chunks of the same lod
+      are stitched across one of their faces the same way, their cubes may split a face differently.
+    The case table doesn't end the surface on a face the same way from both sides everywhere, a case may even skip
+    a crossing of its face - such gaps can't be closed by flat triangles and stay open, as they do inside a chunk.
+    mc-bench -v -L counts the open edges between chunks and compares them with the same field at lod 0.
+    Normals are computed per chunk.
+*/
+
+#include "MarchingCubes.h"
+#include <algorithm>
+
+void MarchingCubes::initLodMesh( LodMesh& mesh, int chunkShift )
+{
+	int size = 1 << chunkShift;
+	mesh.chunkShift = chunkShift;
+	mesh.chunkNumX = (max( field->getSizeX()-1, 1 ) + size-1) >> chunkShift;
+	mesh.chunkNumY = (max( field->getSizeY()-1, 1 ) + size-1) >> chunkShift;
+	mesh.chunkNumZ = (max( field->getSizeZ()-1, 1 ) + size-1) >> chunkShift;
+
+	int num = mesh.chunkNumX * mesh.chunkNumY * mesh.chunkNumZ;
+	mesh.chunks.clear();
+	mesh.chunks.resize( num );
+	mesh.lods.assign( num, 0 );
+	mesh.stitchStart.assign( num, 0 );
+}
+
+void MarchingCubes::selectLods( LodMesh& mesh, const Vector3F& eye, float distance, int maxLod )
+{
+	int cubes[3] = { field->getSizeX()-1, field->getSizeY()-1, field->getSizeZ()-1 };
+	int shift = mesh.chunkShift;
+
+	for( int cz = 0; cz < mesh.chunkNumZ; cz++ )
+	for( int cy = 0; cy < mesh.chunkNumY; cy++ )
+	for( int cx = 0; cx < mesh.chunkNumX; cx++ )
+	{
+		int pos[3] = { cx, cy, cz };
+		float dist2 = 0.0f;
+		for( int a = 0; a < 3; a++ ) {
+			float lo = (float)(pos[a] << shift);
+			float hi = (float)min( (pos[a]+1) << shift, cubes[a] );
+			float d = eye.f[a] < lo ? lo - eye.f[a] : (eye.f[a] > hi ? eye.f[a] - hi : 0.0f);
+			dist2 += d*d;
+		}
+
+		float dist = sqrtf( dist2 );
+		int lod = 0;
+		while( lod < maxLod && dist >= distance * (1 << lod) )
+			lod++;
+		mesh.setLod( cx, cy, cz, lod );
+	}
+}
+
+int MarchingCubes::fillInTrianglesLod( LodMesh& mesh )
+{
+	int size = 1 << mesh.chunkShift;
+	if( mesh.chunkNumX != (max( field->getSizeX()-1, 1 ) + size-1) >> mesh.chunkShift ||
+		mesh.chunkNumY != (max( field->getSizeY()-1, 1 ) + size-1) >> mesh.chunkShift ||
+		mesh.chunkNumZ != (max( field->getSizeZ()-1, 1 ) + size-1) >> mesh.chunkShift )
+		initLodMesh( mesh, mesh.chunkShift );
+
+	if( field->getSizeX() < 2 || field->getSizeY() < 2 || field->getSizeZ() < 2 ) {
+		for( size_t c = 0; c < mesh.chunks.size(); c++ )
+			mesh.chunks[c].clear();
+		return 0;
+	}
+
+	// the worker needs the cache of the whole chunk to find vertices on its faces after it's generated
+	VoxelField chunkField;
+	MarchingCubes worker( *this, chunkField );
+	worker.setCacheMode( CACHE_FULL );
+	// normals are computed again for the real cube sizes anyway
+	worker.setNormalMode( NORMAL_TRIANGLES );
+
+	int triNum = 0;
+	for( int cz = 0; cz < mesh.chunkNumZ; cz++ )
+	for( int cy = 0; cy < mesh.chunkNumY; cy++ )
+	for( int cx = 0; cx < mesh.chunkNumX; cx++ )
+	{
+		_fillLodChunk( mesh, cx, cy, cz, chunkField, worker );
+		triNum += mesh.getChunk( cx, cy, cz ).triNum;
+	}
+	return triNum;
+}
+
+float MarchingCubes::_lodSample( const LodMesh& mesh, int x, int y, int z )
+{
+	int p[3] = { x, y, z };
+	int last[3] = { field->getSizeX()-1, field->getSizeY()-1, field->getSizeZ()-1 };
+	int num[3] = { mesh.chunkNumX, mesh.chunkNumY, mesh.chunkNumZ };
+	int shift = mesh.chunkShift;
+
+	// chunks touching the sample, a sample on a chunk border belongs to chunks on both sides
+	int c0[3], c1[3];
+	for( int a = 0; a < 3; a++ ) {
+		c1[a] = min( p[a] >> shift, num[a]-1 );
+		c0[a] = (p[a] > 0 && !(p[a] & ((1 << shift)-1))) ? (p[a]-1) >> shift : c1[a];
+	}
+	int lod = 0;
+	for( int cz = c0[2]; cz <= c1[2]; cz++ )
+	for( int cy = c0[1]; cy <= c1[1]; cy++ )
+	for( int cx = c0[0]; cx <= c1[0]; cx++ )
+		lod = max( lod, min( mesh.getLod( cx, cy, cz ), shift ) );
+	int stride = 1 << lod;
+
+	// cell of the coarsest grid holding the sample, the last cell along each axis ends at the last sample
+	int lo[3], hi[3];
+	bool onGrid = true;
+	for( int a = 0; a < 3; a++ ) {
+		lo[a] = p[a] & ~(stride-1);
+		hi[a] = min( lo[a] + stride, last[a] );
+		if( p[a] == lo[a] || p[a] == hi[a] )
+			lo[a] = hi[a] = p[a];
+		else
+			onGrid = false;
+	}
+	if( onGrid ) {
+		float val;
+		field->getVal( x, y, z, &val );
+		return val;
+	}
+
+	// linear along axes where the sample is inside the cell, corners may be shared with even coarser chunks
+	float res = 0.0f;
+	for( int c = 0; c < 8; c++ )
+	{
+		int q[3] = { lo[0], lo[1], lo[2] };
+		float w = 1.0f;
+		for( int a = 0; a < 3 && w > 0.0f; a++ ) {
+			int bit = (c >> a) & 1;
+			if( lo[a] == hi[a] ) {
+				q[a] = lo[a];
+				w = bit ? 0.0f : w;
+				continue;
+			}
+			float t = (float)(p[a] - lo[a]) / (hi[a] - lo[a]);
+			q[a] = bit ? hi[a] : lo[a];
+			w *= bit ? t : 1.0f - t;
+		}
+		if( w > 0.0f )
+			res += w * _lodSample( mesh, q[0], q[1], q[2] );
+	}
+	return res;
+}
+
+void MarchingCubes::_lodChunkGrid( const LodMesh& mesh, const int pos[3], int lod, int lo[3], int hi[3], int num[3] )
+{
+	int cubes[3] = { field->getSizeX()-1, field->getSizeY()-1, field->getSizeZ()-1 };
+	for( int a = 0; a < 3; a++ ) {
+		lo[a] = pos[a] << mesh.chunkShift;
+		hi[a] = min( lo[a] + (1 << mesh.chunkShift), cubes[a] );
+		num[a] = (hi[a] - lo[a] + (1 << lod)-1) >> lod;
+	}
+}
+
+float MarchingCubes::_lodChunkSample( const LodMesh& mesh, const int lo[3], const int hi[3], const int num[3], int lod, const int g[3] )
+{
+	int p[3];
+	bool border = false;
+	for( int a = 0; a < 3; a++ ) {
+		p[a] = min( lo[a] + (g[a] << lod), hi[a] );
+		border |= g[a] == 0 || g[a] == num[a];
+	}
+	if( border )
+		return _lodSample( mesh, p[0], p[1], p[2] );
+
+	float val;
+	field->getVal( p[0], p[1], p[2], &val );
+	return val;
+}
+
+void MarchingCubes::_fillLodChunk( LodMesh& mesh, int cx, int cy, int cz, VoxelField& chunkField, MarchingCubes& worker )
+{
+	int pos[3] = { cx, cy, cz };
+	int chunkNum[3] = { mesh.chunkNumX, mesh.chunkNumY, mesh.chunkNumZ };
+	int shift = mesh.chunkShift;
+	int lod = min( max( mesh.getLod( cx, cy, cz ), 0 ), shift );
+	int stride = 1 << lod;
+
+	int lo[3], hi[3], num[3];
+	_lodChunkGrid( mesh, pos, lod, lo, hi, num );
+
+	int index = (cz*mesh.chunkNumY + cy)*mesh.chunkNumX + cx;
+	Mesh& chunk = mesh.chunks[index];
+	chunk.clear();
+	mesh.stitchStart[index] = 0;
+
+	// interpolated border samples are between samples of the chunk's faces, so the brick index covers them too
+	if( field->hasBrickIndex() )
+	{
+		bool surface = false;
+		for( int bz = lo[2] >> VoxelField::BRICK_SHIFT; bz <= (hi[2]-1) >> VoxelField::BRICK_SHIFT && !surface; bz++ )
+		for( int by = lo[1] >> VoxelField::BRICK_SHIFT; by <= (hi[1]-1) >> VoxelField::BRICK_SHIFT && !surface; by++ )
+		for( int bx = lo[0] >> VoxelField::BRICK_SHIFT; bx <= (hi[0]-1) >> VoxelField::BRICK_SHIFT; bx++ ) {
+			if( field->getBrickMax( bx, by, bz ) >= isoValue && field->getBrickMin( bx, by, bz ) < isoValue ) {
+				surface = true;
+				break;
+			}
+		}
+		if( !surface )
+			return;
+	}
+
+	chunkField.setSize( num[0]+1, num[1]+1, num[2]+1 );
+	int g[3];
+	for( g[2] = 0; g[2] <= num[2]; g[2]++ )
+	for( g[1] = 0; g[1] <= num[1]; g[1]++ )
+	for( g[0] = 0; g[0] <= num[0]; g[0]++ )
+		chunkField.setVal( g[0], g[1], g[2], _lodChunkSample( mesh, lo, hi, num, lod, g ) );
+
+	worker.fillInTrianglesIndexed( chunk );
+	int ownTris = chunk.triNum;
+
+	vector<unsigned char> coarseCodes;
+	for( int axis = 0; axis < 3; axis++ )
+	for( int side = 0; side < 2; side++ )
+	{
+		int n[3] = { cx, cy, cz };
+		n[axis] += side ? 1 : -1;
+		if( n[axis] < 0 || n[axis] >= chunkNum[axis] )
+			continue;
+
+		// a chunk of the same lod splits ambiguous faces its own way, one of the two closes the gap like a cap plane
+		int nlod = min( max( mesh.getLod( n[0], n[1], n[2] ), 0 ), shift );
+		if( nlod < lod || (nlod == lod && !side) )
+			continue;
+
+		// cases of the neighbour's cubes touching the face, they decide how its crossings are paired
+		int nlo[3], nhi[3], nnum[3];
+		_lodChunkGrid( mesh, n, nlod, nlo, nhi, nnum );
+		int u = (axis+1) % 3;
+		int v = (axis+2) % 3;
+		int layer = side ? 0 : nnum[axis]-1;
+		coarseCodes.resize( (size_t)nnum[u] * nnum[v] );
+		for( int sj = 0; sj < nnum[v]; sj++ )
+		for( int si = 0; si < nnum[u]; si++ )
+		{
+			int code = 0;
+			for( int c = 0; c < 8; c++ ) {
+				g[axis] = layer + ((c >> axis) & 1);
+				g[u] = si + ((c >> u) & 1);
+				g[v] = sj + ((c >> v) & 1);
+				if( _lodChunkSample( mesh, nlo, nhi, nnum, nlod, g ) >= isoValue )
+					code |= 1 << c;
+			}
+			coarseCodes[ sj*nnum[u] + si ] = (unsigned char)code;
+		}
+		worker._stitchLodFace( axis, side, num, 1 << (nlod - lod), coarseCodes.data() );
+	}
+	// stitching may add vertices of crossings no case of the chunk needed
+	chunk.vertexNum = worker.currentVertex;
+	chunk.triNum = worker.currentTriangle;
+	mesh.stitchStart[index] = ownTris;
+
+	// chunk samples to field coordinates, normals again for the real cube sizes, without the flat stitching triangles
+	for( int v = 0; v < chunk.vertexNum; v++ )
+	{
+		Vector3F& p = chunk.vert[v].pos;
+		for( int a = 0; a < 3; a++ ) {
+			int c = min( (int)p.f[a], num[a]-1 );
+			float t = p.f[a] - c;
+			float g0 = (float)min( lo[a] + c*stride, hi[a] );
+			float g1 = (float)min( lo[a] + (c+1)*stride, hi[a] );
+			p.f[a] = g0 + t * (g1 - g0);
+		}
+		chunk.vert[v].norm.setValue( 0.0f, 0.0f, 0.0f );
+	}
+	for( int t = 0; t < ownTris; t++ )
+	{
+		TriangleI& tri = chunk.tris[t];
+		Vector3F normal = getTriangleNormal( chunk.vert[ tri[0] ].pos, chunk.vert[ tri[1] ].pos, chunk.vert[ tri[2] ].pos );
+		if( normal.isNotZero() ) {
+			normal.normalise();
+			for( int i = 0; i < 3; i++ )
+				chunk.vert[ tri[i] ].norm += normal;
+		}
+	}
+	// a vertex with degenerate triangles only keeps a zero normal
+	for( int v = 0; v < chunk.vertexNum; v++ ) {
+		if( chunk.vert[v].norm.isNotZero() )
+			chunk.vert[v].norm.normalise();
+	}
+}
+
+int MarchingCubes::_lodFaceVertex( int axis, int side, const int num[3], int i, int j, int di, int dj )
+{
+	int u = (axis+1) % 3;
+	int v = (axis+2) % 3;
+
+	// the cube owning the edge, bit 'a' of a corner is its offset along axis a
+	int cube[3];
+	cube[axis] = side ? num[axis]-1 : 0;
+	cube[u] = min( i, num[u]-1 );
+	cube[v] = min( j, num[v]-1 );
+	int c1 = (side << axis) | ((i - cube[u]) << u) | ((j - cube[v]) << v);
+	int c2 = (side << axis) | ((i + di - cube[u]) << u) | ((j + dj - cube[v]) << v);
+
+	for( int e = 0; e < 12; e++ ) {
+		const int* ev = table->edgeToVertex[e];
+		if( (ev[0] != c1 || ev[1] != c2) && (ev[0] != c2 || ev[1] != c1) )
+			continue;
+
+		// a case which skips one crossing of an ambiguous face doesn't create its vertex, the stitching needs it
+		for( int c = 0; c < 8; c++ )
+			field->getVal( cube[0] + (c & 1), cube[1] + ((c >> 1) & 1), cube[2] + ((c >> 2) & 1), &vertex[c] );
+		return _cacheVertex( cube[0], cube[1], cube[2], e );
+	}
+	return -1;
+}
+
+void MarchingCubes::_stitchLodFace( int axis, int side, const int num[3], int ratio, const unsigned char* coarseCodes )
+{
+	int u = (axis+1) % 3;
+	int v = (axis+2) % 3;
+	int squaresU = (num[u] + ratio-1) / ratio;
+
+	// the face of the chunk, in (i,j) = (u,v) sample coordinates
+	auto inside = [&]( int i, int j ) {
+		int g[3];
+		g[axis] = side ? num[axis] : 0;
+		g[u] = i;
+		g[v] = j;
+		float val;
+		field->getVal( g[0], g[1], g[2], &val );
+		return val >= isoValue;
+	};
+
+	// fine vertex on the side of a coarse square between two of its corners, values along the side are linear,
+	//		so the surface crosses it once at most
+	auto crossing = [&]( int i, int j, int i2, int j2 ) {
+		int di = i2 > i ? 1 : (i2 < i ? -1 : 0);
+		int dj = j2 > j ? 1 : (j2 < j ? -1 : 0);
+		if( inside( i, j ) == inside( i2, j2 ) )
+			return -1;
+		while( inside( i, j ) == inside( i+di, j+dj ) ) {
+			i += di;
+			j += dj;
+		}
+		return _lodFaceVertex( axis, side, num, min( i, i+di ), min( j, j+dj ), di != 0, dj != 0 );
+	};
+
+	// edges where the surface of either chunk ends on the face, each of them as (vertex, vertex)
+	vector< pair<int,int> > links;
+	// edges of the case's triangles lying in the cube's side at 'faceSide' along the axis, edges between two
+	//		triangles of the case come twice and cancel out, the rest is where its surface ends on the side
+	//		a tunnel or a bent split of an ambiguous side leaves more than two of them
+	auto addBoundary = [&]( int code, int faceSide, const int vert[12] ) {
+		auto onFace = [&]( int e ) {
+			return ((table->edgeToVertex[e][0] >> axis) & 1) == faceSide && ((table->edgeToVertex[e][1] >> axis) & 1) == faceSide;
+		};
+		const MarchingCubesCase& cubeCase = table->triangleTable[code];
+		int edges[24][2];
+		int edgeNum = 0;
+		for( int t = 0; t < cubeCase.numTri; t++ )
+		for( int k = 0; k < 3; k++ )
+		{
+			int ea = min( cubeCase.tris[t][k], cubeCase.tris[t][(k+1) % 3] );
+			int eb = max( cubeCase.tris[t][k], cubeCase.tris[t][(k+1) % 3] );
+			if( !onFace( ea ) || !onFace( eb ) )
+				continue;
+
+			int r = 0;
+			while( r < edgeNum && !(edges[r][0] == ea && edges[r][1] == eb) )
+				r++;
+			if( r < edgeNum ) {
+				edges[r][0] = edges[edgeNum-1][0];
+				edges[r][1] = edges[edgeNum-1][1];
+				edgeNum--;
+			}
+			else {
+				edges[edgeNum][0] = ea;
+				edges[edgeNum][1] = eb;
+				edgeNum++;
+			}
+		}
+		for( int r = 0; r < edgeNum; r++ ) {
+			int a = vert[ edges[r][0] ], b = vert[ edges[r][1] ];
+			if( a < 0 || b < 0 )
+				return false;
+			links.push_back( make_pair( min( a, b ), max( a, b ) ) );
+		}
+		return true;
+	};
+
+	vector< pair<int,int> > coarse;
+	vector<int> loop;
+	vector<bool> used;
+	vector< pair<int,int> > shared;
+	vector<bool> sharedUsed;
+	for( int j0 = 0; j0 < num[v]; j0 += ratio )
+	for( int i0 = 0; i0 < num[u]; i0 += ratio )
+	{
+		int i1 = min( i0 + ratio, num[u] );
+		int j1 = min( j0 + ratio, num[v] );
+		links.clear();
+		if( !_reserveCube() )
+			return;
+
+		// the coarse cube, its case pairs the crossings of an ambiguous face the way the coarse chunk does,
+		//		each crossing is the fine vertex on the side of the square
+		int vert[12];
+		for( int e = 0; e < 12; e++ )
+		{
+			vert[e] = -1;
+			int c1 = table->edgeToVertex[e][0];
+			int c2 = table->edgeToVertex[e][1];
+			if( ((c1 >> axis) & 1) != 1-side || ((c2 >> axis) & 1) != 1-side )
+				continue;
+			vert[e] = crossing( (c1 >> u) & 1 ? i1 : i0, (c1 >> v) & 1 ? j1 : j0,
+								(c2 >> u) & 1 ? i1 : i0, (c2 >> v) & 1 ? j1 : j0 );
+		}
+		bool valid = addBoundary( coarseCodes[ (j0/ratio)*squaresU + i0/ratio ], 1-side, vert );
+		coarse = links;
+
+		// fine cubes of the chunk under the square, with their own split of ambiguous faces
+		for( int j = j0; j < j1 && valid; j++ )
+		for( int i = i0; i < i1 && valid; i++ )
+		{
+			int cube[3];
+			cube[axis] = side ? num[axis]-1 : 0;
+			cube[u] = i;
+			cube[v] = j;
+			int code = 0;
+			for( int c = 0; c < 8; c++ ) {
+				float val;
+				field->getVal( cube[0] + (c & 1), cube[1] + ((c >> 1) & 1), cube[2] + ((c >> 2) & 1), &val );
+				if( val >= isoValue )
+					code |= 1 << c;
+			}
+			if( code == 0 || code == 255 )
+				continue;
+			for( int e = 0; e < 12; e++ )
+				vert[e] = _cacheEntry( cube[0], cube[1], cube[2], e )->vertex;
+			valid = addBoundary( code, side, vert );
+		}
+		if( !valid )
+			continue;
+
+		// an edge both surfaces end on is closed already, the gap is bounded by the rest
+		sort( links.begin(), links.end() );
+		shared.clear();
+		size_t open = 0;
+		for( size_t l = 0; l < links.size(); ) {
+			if( l+1 < links.size() && links[l] == links[l+1] ) {
+				shared.push_back( links[l] );
+				l += 2;
+			}
+			else
+				links[open++] = links[l++];
+		}
+		links.resize( open );
+
+		// the gap splits into closed loops, each of them is a flat polygon filled with a fan
+		//		where one chunk has a tunnel through an ambiguous face and the other splits it, the rest doesn't close,
+		//		the loop goes on along a closed edge then - the polygon of all crossings, the same quad a cap plane adds
+		used.assign( links.size(), false );
+		sharedUsed.assign( shared.size(), false );
+		for( size_t l = 0; l < links.size(); l++ )
+		{
+			if( used[l] )
+				continue;
+			loop.clear();
+			loop.push_back( links[l].first );
+			int last = links[l].second;
+			used[l] = true;
+			while( last != loop[0] ) {
+				size_t next = 0;
+				while( next < links.size() && (used[next] || (links[next].first != last && links[next].second != last)) )
+					next++;
+				if( next < links.size() ) {
+					used[next] = true;
+					loop.push_back( last );
+					last = links[next].first == last ? links[next].second : links[next].first;
+					continue;
+				}
+
+				next = 0;
+				while( next < shared.size() && (sharedUsed[next] || (shared[next].first != last && shared[next].second != last)) )
+					next++;
+				if( next == shared.size() )
+					break;
+				sharedUsed[next] = true;
+				loop.push_back( last );
+				last = shared[next].first == last ? shared[next].second : shared[next].first;
+			}
+			// cases which end the surface on the face in ways that don't meet even this way leave it open
+			if( last != loop[0] )
+				continue;
+
+			for( size_t k = 1; k+1 < loop.size(); k++ )
+			{
+				int a = loop[k];
+				int b = loop[k+1];
+				Vector3F p = _outPos( loop[0] );
+				Vector3F va = _outPos( a );
+				Vector3F vb = _outPos( b );
+
+				// whether the coarse face is inside at the centre - it changes at every coarse segment
+				//		on the way from a corner of the square
+				float cu = (p.f[u] + va.f[u] + vb.f[u]) / 3.0f;
+				float cv = (p.f[v] + va.f[v] + vb.f[v]) / 3.0f;
+				bool coarseInside = inside( i0, j0 );
+				for( size_t c = 0; c < coarse.size(); c++ ) {
+					Vector3F s0 = _outPos( coarse[c].first );
+					Vector3F s1 = _outPos( coarse[c].second );
+					auto sideOf = []( float au, float av, float bu, float bv, float pu, float pv ) {
+						return (bu - au) * (pv - av) - (bv - av) * (pu - au);
+					};
+					float d0 = sideOf( s0.f[u], s0.f[v], s1.f[u], s1.f[v], (float)i0, (float)j0 );
+					float d1 = sideOf( s0.f[u], s0.f[v], s1.f[u], s1.f[v], cu, cv );
+					float d2 = sideOf( (float)i0, (float)j0, cu, cv, s0.f[u], s0.f[v] );
+					float d3 = sideOf( (float)i0, (float)j0, cu, cv, s1.f[u], s1.f[v] );
+					if( (d0 > 0.0f) != (d1 > 0.0f) && (d2 > 0.0f) != (d3 > 0.0f) )
+						coarseInside = !coarseInside;
+				}
+
+				// where the gap is inside the coarse chunk the surface faces the finer chunk, otherwise the coarse one
+				//		the finer chunk is on the +axis side of its -axis face
+				bool positive = coarseInside == (side == 0);
+
+				Vector3F n;
+				Vector3F da = va - p;
+				Vector3F db = vb - p;
+				getCrossProduct( da.f, db.f, n.f );
+				// cross products of generated triangles point towards negative values, stitching ones have to match
+				if( (n.f[axis] < 0.0f) == positive )
+					swap( a, b );
+
+				if( !_reserveCube() )
+					return;
+				_setTriangle( loop[0], a, b );
+				currentTriangle++;
+			}
+		}
+	}
+}
@@ -0,0 +1,632 @@
+/*
+    MarchingCubes - main class for all Marching Cubes computations
+    Author: Karol Herda
+    Web:    http://kolenda.me/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Multithreaded extraction - the field is split into z-slabs, every slab is generated
+    by a worker object with its own cache, then all slabs are merged into one indexed mesh.
+
+    Two-pass extraction - the first pass finds which edges get a vertex and how many triangles
+    every cube row has, prefix sums of those give each row its place in the output.
+    The second pass writes vertices and triangles straight to those places, so the output
+    can be allocated exactly and nothing has to be merged or dropped.
+
+    Batch extraction - many small separate fields, like chunks of a voxel world, are handed out to workers
+    kept by the master object. A worker is pointed at the next field and generates it with its old cache,
+    which isn't even reallocated when the field has the same size as the previous one.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include "MarchingCubes.h"
+
+// runs fn( index, threadIndex ) for all indices in [0,count) on 'threadNum' threads
+template<class F>
+static void parallelFor( int count, int threadNum, F fn )
+{
+	std::atomic<int> next( 0 );
+
+	auto work = [&]( int thread ) {
+		for( int i = next++; i < count; i = next++ )
+			fn( i, thread );
+	};
+
+	vector<std::thread> threads;
+	for( int t = 1; t < threadNum && t < count; t++ )
+		threads.push_back( std::thread( work, t ) );
+	work( 0 );
+
+	for( size_t t = 0; t < threads.size(); t++ )
+		threads[t].join();
+}
+
+void MarchingCubes::_fillSlab( SlabResult& slab )
+{
+	int sizeX = field->getSizeX();
+	int sizeY = field->getSizeY();
+
+	// in full mode cache holds all planes touched by the slab, including its top plane z1
+	_cacheAlloc( sizeX, sizeY, slab.z1 - slab.z0 + 1 );
+	_cacheClear();
+	_setOutput( slab.mesh );
+
+	currentTriangle	= 0;
+	currentVertex	= 0;
+	truncated		= false;
+
+	// cubes right below the slab belong to another worker, but their top faces have to be known
+	// to cap our bottom faces the same way the single threaded loop does
+	if( slab.z0 > 0 )
+	{
+		for( int y = 0; y < sizeY-1; y++ )
+		for( int x = 0; x < sizeX-1; x++ )
+		{
+			Cube2 cube = field->getCube( x, y, slab.z0-1 );
+			setValues( cube );
+
+			int p = getCaseFromValues().capPlanesTab[5];
+			if( p != 0 )
+				_cacheEntryFromPlane( x, y, slab.z0-1, 5 )->capPlane = p;
+		}
+	}
+
+	for( int z = slab.z0; z < slab.z1; z++ )
+	{
+		_marchLayer( z );
+
+		// rolling cache reuses the bottom plane for the next layer
+		if( z == slab.z0 )
+			_getSeam( slab.z0, slab.bottomSeam );
+	}
+
+	slab.mesh.vertexNum = currentVertex;
+	slab.mesh.triNum = currentTriangle;
+
+	_getSeam( slab.z1, slab.topSeam );
+}
+
+void MarchingCubes::_getSeam( int z, vector<int>& seam )
+{
+	int sizeX = field->getSizeX();
+	int sizeY = field->getSizeY();
+
+	seam.resize( sizeX * sizeY * 2 );
+	for( int y = 0; y < sizeY; y++ )
+	for( int x = 0; x < sizeX; x++ )
+	{
+		// edges 0 and 1 go along x and y from the cube origin, both lie on the z plane
+		int* seamXY = &seam[ (y * sizeX + x) * 2 ];
+		seamXY[0] = _cacheEntry( x, y, z, 0 )->vertex;
+		seamXY[1] = _cacheEntry( x, y, z, 1 )->vertex;
+	}
+}
+
+int MarchingCubes::fillInTrianglesIndexedParallel( MarchingCubes::Vertex* vert, int maxVert, MarchingCubes::TriangleI* tris, int maxTris,
+													int& vertexNum, int& triNum, int threadNum )
+{
+	return _fillParallel( vert, maxVert, tris, maxTris, NULL, vertexNum, triNum, threadNum );
+}
+
+int MarchingCubes::fillInTrianglesIndexedParallel( Mesh& mesh, int threadNum )
+{
+	mesh.clear();
+	return _fillParallel( NULL, INT_MAX, NULL, INT_MAX, &mesh, mesh.vertexNum, mesh.triNum, threadNum );
+}
+
+int MarchingCubes::fillInTrianglesBatch( VoxelField* const* fields, int fieldNum, Mesh* meshes, int threadNum )
+{
+	truncated = false;
+	if( fieldNum <= 0 )
+		return 0;
+
+	if( threadNum <= 0 )
+		threadNum = std::thread::hardware_concurrency();
+	threadNum = max( min( threadNum, fieldNum ), 1 );
+
+	// settings of the master are taken again by every batch, caches survive unless the cache mode changed
+	while( (int)batchWorkers.size() < threadNum )
+		batchWorkers.push_back( new MarchingCubes( *this ) );
+	for( int t = 0; t < threadNum; t++ )
+	{
+		MarchingCubes* worker = batchWorkers[t];
+		worker->setCacheMode( cacheMode );
+		worker->isoValue = isoValue;
+		worker->normalMode = normalMode;
+		if( worker->traversalMode != traversalMode || worker->traversalTile != traversalTile )
+			worker->setTraversalMode( traversalMode, traversalTile );
+	}
+
+	parallelFor( fieldNum, threadNum, [&]( int i, int t ) {
+		MarchingCubes* worker = batchWorkers[t];
+		worker->field = fields[i];
+		worker->fillInTrianglesIndexed( meshes[i] );
+	});
+
+	for( int t = 0; t < threadNum; t++ )
+	{
+		MarchingCubes* worker = batchWorkers[t];
+		for( int i = 0; i < 256; i++ )
+			usageStats[i] += worker->usageStats[i];
+		memset( worker->usageStats, 0, sizeof(worker->usageStats) );
+		// fields of the batch may be gone before the next one
+		worker->field = field;
+	}
+
+	int triNum = 0;
+	for( int i = 0; i < fieldNum; i++ )
+		triNum += meshes[i].triNum;
+	return triNum;
+}
+
+int MarchingCubes::_fillParallel( MarchingCubes::Vertex* vert, int maxVert, MarchingCubes::TriangleI* tris, int maxTris, Mesh* mesh,
+									int& vertexNum, int& triNum, int threadNum )
+{
+	int cubesZ = field->getSizeZ() - 1;
+
+	vertexNum = 0;
+	triNum = 0;
+	truncated = false;
+	if( cubesZ < 1 || field->getSizeX() < 2 || field->getSizeY() < 2 )
+		return 0;
+
+	if( threadNum <= 0 )
+		threadNum = std::thread::hardware_concurrency();
+	if( threadNum <= 0 )
+		threadNum = 1;
+
+	// a few slabs per thread, so threads which got empty slabs can help with the rest
+	int slabNum = min( threadNum * 4, cubesZ );
+
+	// slab meshes are kept, so they stop growing after a few fills
+	vector<SlabResult>& slabs = parallelSlabs;
+	slabs.resize( slabNum );
+	for( int s = 0; s < slabNum; s++ )
+	{
+		slabs[s].z0 = cubesZ * s / slabNum;
+		slabs[s].z1 = cubesZ * (s+1) / slabNum;
+	}
+
+	vector<MarchingCubes*> workers( min( threadNum, slabNum ) );
+	for( size_t t = 0; t < workers.size(); t++ )
+		workers[t] = new MarchingCubes( *this );
+
+	parallelFor( slabNum, (int)workers.size(), [&]( int s, int t ) {
+		workers[t]->_fillSlab( slabs[s] );
+	});
+
+	for( size_t t = 0; t < workers.size(); t++ ) {
+		for( int i = 0; i < 256; i++ )
+			usageStats[i] += workers[t]->usageStats[i];
+		delete workers[t];
+	}
+
+	// seam vertices created by both neighbours belong to the lower slab
+	parallelFor( slabNum, threadNum, [&]( int s, int ) {
+		SlabResult& slab = slabs[s];
+		slab.shared.clear();
+		if( s == 0 )
+			return;
+
+		vector<int>& lowerTop = slabs[s-1].topSeam;
+		for( size_t k = 0; k < slab.bottomSeam.size(); k++ ) {
+			if( slab.bottomSeam[k] >= 0 && lowerTop[k] >= 0 ) {
+				slab.shared.push_back( slab.bottomSeam[k] );
+				slab.shared.push_back( lowerTop[k] );
+			}
+		}
+	});
+
+	// place slabs one after another, the rest is dropped once the output is full
+	int usedSlabs = 0;
+	for( int s = 0; s < slabNum; s++ )
+	{
+		SlabResult& slab = slabs[s];
+		int ownVertices = slab.mesh.vertexNum - (int)slab.shared.size() / 2;
+
+		if( vertexNum > maxVert - ownVertices ||
+			triNum > maxTris - slab.mesh.triNum )
+			break;
+
+		slab.vertBase = vertexNum;
+		slab.triBase = triNum;
+		vertexNum += ownVertices;
+		triNum += slab.mesh.triNum;
+		usedSlabs++;
+	}
+
+	if( mesh ) {
+		mesh->reserve( vertexNum, triNum );
+		vert = mesh->getVertices();
+		tris = mesh->getTriangles();
+	}
+
+	// local to global vertex indices
+	parallelFor( usedSlabs, threadNum, [&]( int s, int ) {
+		SlabResult& slab = slabs[s];
+		slab.remap.assign( slab.mesh.vertexNum, 0 );
+
+		for( size_t i = 0; i < slab.shared.size(); i += 2 )
+			slab.remap[ slab.shared[i] ] = -1;
+
+		int next = slab.vertBase;
+		for( int v = 0; v < slab.mesh.vertexNum; v++ ) {
+			if( slab.remap[v] == 0 )
+				slab.remap[v] = next++;
+		}
+	});
+
+	parallelFor( usedSlabs, threadNum, [&]( int s, int ) {
+		SlabResult& slab = slabs[s];
+
+		for( size_t i = 0; i < slab.shared.size(); i += 2 )
+			slab.remap[ slab.shared[i] ] = slabs[s-1].remap[ slab.shared[i+1] ];
+
+		const Vertex* slabVert = slab.mesh.getVertices();
+		for( int v = 0; v < slab.mesh.vertexNum; v++ ) {
+			if( slab.remap[v] >= slab.vertBase )
+				vert[ slab.remap[v] ] = slabVert[v];
+		}
+
+		const TriangleI* slabTris = slab.mesh.getTriangles();
+		for( int t = 0; t < slab.mesh.triNum; t++ ) {
+			TriangleI& tri = tris[ slab.triBase + t ];
+			for( int i = 0; i < 3; i++ )
+				tri.i[i] = slab.remap[ slabTris[t].i[i] ];
+		}
+	});
+
+	// gradient normals of seam vertices are the same in both slabs, they are already complete
+	if( normalMode == NORMAL_TRIANGLES )
+	{
+		// seam vertices collect normals from both slabs
+		for( int s = 1; s < usedSlabs; s++ )
+		{
+			SlabResult& slab = slabs[s];
+			for( size_t i = 0; i < slab.shared.size(); i += 2 ) {
+				int local = slab.shared[i];
+				vert[ slab.remap[local] ].norm += slab.mesh.getVertices()[local].norm;
+			}
+		}
+
+		parallelFor( usedSlabs, threadNum, [&]( int s, int ) {
+			SlabResult& slab = slabs[s];
+			int end = (s+1 < usedSlabs) ? slabs[s+1].vertBase : vertexNum;
+			for( int v = slab.vertBase; v < end; v++ )
+				vert[v].norm.normalise();
+		});
+	}
+
+	truncated = usedSlabs < slabNum;
+	return triNum;
+}
+
+
+void MarchingCubes::_markLayer( const unsigned char* codes, const unsigned char* codesBelow,
+								unsigned char* marks, unsigned char* marksAbove, int* rowTris )
+{
+	int sizeX = field->getSizeX();
+	int cubesX = sizeX-1;
+	int cubesY = field->getSizeY()-1;
+
+	for( int y = 0; y < cubesY; y++, codes += cubesX )
+	{
+		int triNum = 0;
+		for( int x = 0; x < cubesX; x++ )
+		{
+			int code = codes[x];
+			if( code == 0 || code == 255 )
+				continue;
+
+			const MarchingCubesCase& cubeCase = table->triangleTable[code];
+			int edges = table->caseEdges[code];
+			triNum += cubeCase.numTri;
+
+			// a cap is generated by the second cube of the pair, with z-y-x order it's always the one
+			// on the positive side, so only bottom faces have to be checked against the previous cubes
+			if( cubeCase.capPlanes )
+			{
+				int prev[3] = {
+					x > 0 ? codes[x-1] : -1,
+					y > 0 ? codes[x-cubesX] : -1,
+					codesBelow ? codesBelow[y*cubesX + x] : -1
+				};
+				for( int axis = 0; axis < 3; axis++ )
+				{
+					int plane = axis * 2;
+					int p = cubeCase.capPlanesTab[plane];
+					if( p != 0 && prev[axis] >= 0 && table->triangleTable[ prev[axis] ].capPlanesTab[plane+1] == p ) {
+						edges |= table->planeEdges[plane];
+						triNum += 2;
+					}
+				}
+			}
+
+			for( int e = 0; e < 12; e++ )
+			{
+				if( edges & (1 << e) ) {
+					const CacheSlot& s = edgeToCacheSlot[e];
+					unsigned char* m = s.dz ? marksAbove : marks;
+					m[ (y + s.dy) * sizeX + x + s.dx ] |= 1 << s.slot;
+				}
+			}
+		}
+
+		if( rowTris )
+			rowTris[y] = triNum;
+	}
+}
+
+template<class P, class L>
+void MarchingCubes::_sweepSlab( int z0, int z1, int* rowTris, P planeDone, L layerDone )
+{
+	int sizeX = field->getSizeX();
+	int sizeY = field->getSizeY();
+	int cubesY = sizeY-1;
+	int cubesZ = field->getSizeZ()-1;
+	int planeSize = sizeX * sizeY;
+
+	for( int i = 0; i < 2; i++ ) {
+		layerCodes[i].resize( (sizeX-1) * cubesY );
+		planeMarks[i].resize( planeSize );
+	}
+
+	// cubes below and above the slab also use edges of its bottom and top plane
+	int zStart = z0 > 0 ? z0-1 : z0;
+	int zEnd = min( z1, cubesZ-1 );
+
+	memset( &planeMarks[zStart & 1][0], 0, planeSize );
+	for( int z = zStart; z <= zEnd; z++ )
+	{
+		unsigned char* codes = &layerCodes[z & 1][0];
+		unsigned char* marksAbove = &planeMarks[(z+1) & 1][0];
+		_classifyLayer( z, codes );
+
+		memset( marksAbove, 0, planeSize );
+		_markLayer( codes, z > zStart ? &layerCodes[(z-1) & 1][0] : NULL,
+					&planeMarks[z & 1][0], marksAbove,
+					(rowTris && z >= z0 && z < z1) ? rowTris + z * cubesY : NULL );
+
+		// no other layer touches plane z
+		if( z >= z0 )
+			planeDone( z );
+		if( z > z0 )
+			layerDone( z-1 );
+	}
+
+	if( z1 == cubesZ ) {
+		planeDone( z1 );
+		layerDone( z1-1 );
+	}
+}
+
+void MarchingCubes::_countSlab( int z0, int z1, int* rowVerts, int* rowTris )
+{
+	static const unsigned char bitCount[8] = { 0, 1, 1, 2, 1, 2, 2, 3 };
+
+	int sizeX = field->getSizeX();
+	int sizeY = field->getSizeY();
+	int cubesZ = field->getSizeZ()-1;
+
+	// the top plane belongs to the next slab, unless it's the last plane of the field
+	auto planeDone = [&]( int z ) {
+		if( z == z1 && z1 < cubesZ )
+			return;
+
+		const unsigned char* marks = &planeMarks[z & 1][0];
+		for( int y = 0; y < sizeY; y++, marks += sizeX )
+		{
+			int vertNum = 0;
+			for( int x = 0; x < sizeX; x++ )
+				vertNum += bitCount[ marks[x] ];
+			rowVerts[ z * sizeY + y ] = vertNum;
+		}
+	};
+
+	_sweepSlab( z0, z1, rowTris, planeDone, []( int ) {} );
+}
+
+void MarchingCubes::_fillSlabCounted( int z0, int z1, bool boundaries, const int* vertBase, const int* triBase,
+										MarchingCubes::Vertex* vert, MarchingCubes::TriangleI* tris )
+{
+	int sizeX = field->getSizeX();
+	int sizeY = field->getSizeY();
+	int cubesX = sizeX-1;
+	int cubesY = sizeY-1;
+	int cubesZ = field->getSizeZ()-1;
+
+	_cacheAlloc( sizeX, sizeY, z1 - z0 + 1 );
+	_cacheClear();
+	// sizes are exact, no cube can run out of space
+	_setOutput( vert, INT_MAX, tris, INT_MAX );
+	currentTriangle	= triBase[ z0 * cubesY ];
+	currentVertex	= 0;
+	truncated		= false;
+
+	// every vertex of the plane gets its global index, so _cacheVertex never has to create one
+	auto planeDone = [&]( int z ) {
+		bool write = boundaries || (z > z0 && z < z1) || z == cubesZ;
+		const unsigned char* marks = &planeMarks[z & 1][0];
+
+		for( int y = 0; y < sizeY; y++, marks += sizeX )
+		{
+			int index = vertBase[ z * sizeY + y ];
+			const float* rows[4];
+			_getRows( y, z, 0, cubesX, rows );
+
+			for( int x = 0; x < sizeX; x++ )
+			for( int slot = 0; slot < 3; slot++ )
+			{
+				if( !(marks[x] & (1 << slot)) )
+					continue;
+
+				_cacheEntry( x,y,z, slot )->vertex = index;
+				if( write )
+				{
+					// the same interpolation as getVertexFromEdge
+					float v1 = rows[0][x];
+					float v2 = slot == 0 ? rows[0][x+1] : rows[slot][x];
+					Vector3F pos( (float)x, (float)y, (float)z );
+					pos.f[slot] += (v1-isoValue)/(v1-v2);
+
+					vert[index].pos = pos;
+					if( normalMode == NORMAL_GRADIENT )
+						vert[index].norm = _gradientNormal( pos );
+					else
+						vert[index].norm.setValue( 0.0f, 0.0f, 0.0f );
+				}
+				index++;
+			}
+		}
+
+		// top faces of cubes below the slab, the same as in _fillSlab
+		if( z == z0 && z0 > 0 )
+		{
+			const unsigned char* codes = &layerCodes[(z0-1) & 1][0];
+			for( int y = 0; y < cubesY; y++ )
+			for( int x = 0; x < cubesX; x++ )
+			{
+				int p = table->triangleTable[ codes[y * cubesX + x] ].capPlanesTab[5];
+				if( p != 0 )
+					_cacheEntryFromPlane( x, y, z0-1, 5 )->capPlane = p;
+			}
+		}
+	};
+
+	auto layerDone = [&]( int z ) {
+		const unsigned char* codes = &layerCodes[z & 1][0];
+		for( int y = 0; y < cubesY; y++ )
+			_marchRowCodes( y,z, codes + y * cubesX );
+	};
+
+	_sweepSlab( z0, z1, NULL, planeDone, layerDone );
+
+	assert( currentVertex == 0 && currentTriangle == triBase[ z1 * cubesY ] );
+}
+
+// replaces counts with offsets of their first element, returns the total
+static int prefixSum( vector<int>& counts )
+{
+	int sum = 0;
+	for( size_t i = 0; i < counts.size(); i++ ) {
+		int count = counts[i];
+		counts[i] = sum;
+		sum += count;
+	}
+	return sum;
+}
+
+void MarchingCubes::countTrianglesIndexed( int& vertexNum, int& triNum, int threadNum )
+{
+	int sizeY = field->getSizeY();
+	int sizeZ = field->getSizeZ();
+	int cubesZ = sizeZ - 1;
+
+	vertexNum = 0;
+	triNum = 0;
+	countVertBase.clear();
+	countTriBase.clear();
+	countField = field;
+	countSize[0] = field->getSizeX();
+	countSize[1] = sizeY;
+	countSize[2] = sizeZ;
+	countIsoValue = isoValue;
+	if( cubesZ < 1 || field->getSizeX() < 2 || sizeY < 2 )
+		return;
+
+	if( threadNum <= 0 )
+		threadNum = std::thread::hardware_concurrency();
+	if( threadNum <= 0 )
+		threadNum = 1;
+	countThreadNum = threadNum;
+
+	// one extra element for the total
+	countVertBase.assign( sizeY * sizeZ + 1, 0 );
+	countTriBase.assign( (sizeY-1) * cubesZ + 1, 0 );
+
+	int slabNum = min( threadNum * 4, cubesZ );
+	vector<MarchingCubes*> workers( min( threadNum, slabNum ) );
+	for( size_t t = 0; t < workers.size(); t++ )
+		workers[t] = new MarchingCubes( *this );
+
+	parallelFor( slabNum, (int)workers.size(), [&]( int s, int t ) {
+		workers[t]->_countSlab( cubesZ * s / slabNum, cubesZ * (s+1) / slabNum, &countVertBase[0], &countTriBase[0] );
+	});
+
+	for( size_t t = 0; t < workers.size(); t++ )
+		delete workers[t];
+
+	vertexNum = prefixSum( countVertBase );
+	triNum = prefixSum( countTriBase );
+}
+
+bool MarchingCubes::_countsMatch() const
+{
+	// offsets of another field or isovalue would send rows past the output
+	return !countVertBase.empty() && countField == field && countIsoValue == isoValue &&
+		countSize[0] == field->getSizeX() && countSize[1] == field->getSizeY() && countSize[2] == field->getSizeZ();
+}
+
+int MarchingCubes::fillInTrianglesIndexedCounted( MarchingCubes::Vertex* vert, MarchingCubes::TriangleI* tris )
+{
+	int cubesZ = field->getSizeZ() - 1;
+
+	truncated = false;
+	if( !_countsMatch() )
+		return 0;
+
+	int slabNum = min( countThreadNum * 4, cubesZ );
+	vector<MarchingCubes*> workers( min( countThreadNum, slabNum ) );
+	for( size_t t = 0; t < workers.size(); t++ )
+		workers[t] = new MarchingCubes( *this );
+
+	// neighbour slabs share vertices of one plane, so they never run at the same time:
+	//	even slabs go first and write their boundary planes, odd slabs only add normals there
+	for( int phase = 0; phase < 2; phase++ )
+	{
+		parallelFor( (slabNum + 1 - phase) / 2, (int)workers.size(), [&]( int i, int t ) {
+			int s = 2*i + phase;
+			workers[t]->_fillSlabCounted( cubesZ * s / slabNum, cubesZ * (s+1) / slabNum, phase == 0,
+											&countVertBase[0], &countTriBase[0], vert, tris );
+		});
+	}
+
+	for( size_t t = 0; t < workers.size(); t++ ) {
+		for( int i = 0; i < 256; i++ )
+			usageStats[i] += workers[t]->usageStats[i];
+		delete workers[t];
+	}
+
+	if( normalMode == NORMAL_GRADIENT )
+		return countTriBase.back();
+
+	int vertexNum = countVertBase.back();
+	int chunkNum = countThreadNum * 4;
+	parallelFor( chunkNum, countThreadNum, [&]( int c, int ) {
+		int end = (int)( (long long)vertexNum * (c+1) / chunkNum );
+		for( int v = (int)( (long long)vertexNum * c / chunkNum ); v < end; v++ )
+			vert[v].norm.normalise();
+	});
+
+	return countTriBase.back();
+}
+
+int MarchingCubes::fillInTrianglesIndexedCounted( Mesh& mesh )
+{
+	mesh.clear();
+	if( !_countsMatch() ) {
+		int vertexNum, triNum;
+		countTrianglesIndexed( vertexNum, triNum, countThreadNum );
+		if( countVertBase.empty() )
+			return 0;
+	}
+
+	mesh.reserve( countVertBase.back(), countTriBase.back() );
+	mesh.triNum = fillInTrianglesIndexedCounted( mesh.getVertices(), mesh.getTriangles() );
+	mesh.vertexNum = mesh.triNum > 0 ? countVertBase.back() : 0;
+	return mesh.triNum;
+}
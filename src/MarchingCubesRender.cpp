@@ -6,7 +6,6 @@
 */
 
 #include <set>
-#include <map>
 #include <stdio.h>
 #include <string.h>
 #include "MarchingCubes.h"
@@ -14,134 +13,403 @@
 
 int MarchingCubes::fillInTrianglesIndexed( MarchingCubes::Vertex* vert, int maxVert, MarchingCubes::TriangleI* tris, int maxTris, int& vertexNum, int& triNum )
 {
-	std::map<int,int>	capPlaneCache;
+	_setOutput( vert, maxVert, tris, maxTris );
+	return _fillField( vertexNum, triNum );
+}
+
+int MarchingCubes::fillInTrianglesIndexed( Mesh& mesh )
+{
+	_setOutput( mesh );
+	return _fillField( mesh.vertexNum, mesh.triNum );
+}
+
+int MarchingCubes::fillInTrianglesIndexed( MarchingCubes::Vector3F* pos, MarchingCubes::Vector3F* norm, int maxVert,
+											MarchingCubes::TriangleI* tris, int maxTris, int& vertexNum, int& triNum )
+{
+	_setOutput( pos, norm, maxVert, tris, maxTris );
+	return _fillField( vertexNum, triNum );
+}
+
+int MarchingCubes::fillInTrianglesIndexed( MeshSoA& mesh )
+{
+	_setOutput( mesh );
+	return _fillField( mesh.vertexNum, mesh.triNum );
+}
+
+void MarchingCubes::_setOutput( MarchingCubes::Vertex* vert, int maxVert, MarchingCubes::TriangleI* tris, int maxTris )
+{
+	_setOutput( vert ? &vert->pos : NULL, vert ? &vert->norm : NULL, maxVert, tris, maxTris );
+	outVertStride = sizeof( Vertex );
+}
+
+void MarchingCubes::_setOutput( MarchingCubes::Vector3F* pos, MarchingCubes::Vector3F* norm, int maxVert,
+								MarchingCubes::TriangleI* tris, int maxTris )
+{
+	outPos			= (char*)pos;
+	outNorm			= (char*)norm;
+	outVertStride	= sizeof( Vector3F );
+	outTris			= tris;
+	outMaxVert		= maxVert;
+	outMaxTris		= maxTris;
+	outVertBase		= 0;
+	outTriBase		= 0;
+	outMesh			= NULL;
+	outMeshSoA		= NULL;
+}
+
+void MarchingCubes::_setOutput( Mesh& mesh )
+{
+	_setOutput( mesh.vert.data(), (int)mesh.vert.size(), mesh.tris.data(), (int)mesh.tris.size() );
+	outMesh = &mesh;
+	mesh.clear();
+}
+
+void MarchingCubes::_setOutput( MeshSoA& mesh )
+{
+	_setOutput( mesh.pos.data(), mesh.norm.data(), (int)mesh.pos.size(), mesh.tris.data(), (int)mesh.tris.size() );
+	outMeshSoA = &mesh;
+	mesh.clear();
+}
+
+bool MarchingCubes::_growOutput()
+{
+	if( !outMesh && !outMeshSoA ) {
+		truncated = true;
+		return false;
+	}
+
+	// doubled, so a mesh growing from empty is copied only a few times
+	int vertNeeded = currentVertex - outVertBase + CUBE_MAX_VERTS;
+	int trisNeeded = currentTriangle - outTriBase + CUBE_MAX_TRIS;
+	size_t vertSize = max( 2 * (size_t)outMaxVert, (size_t)vertNeeded );
+	size_t trisSize = max( 2 * (size_t)outMaxTris, (size_t)trisNeeded );
+
+	Mesh* mesh = outMesh;
+	MeshSoA* meshSoA = outMeshSoA;
+	int vertBase = outVertBase;
+	int triBase = outTriBase;
+
+	if( mesh ) {
+		if( vertNeeded > outMaxVert )
+			mesh->vert.resize( vertSize );
+		if( trisNeeded > outMaxTris )
+			mesh->tris.resize( trisSize );
+		_setOutput( mesh->vert.data(), (int)mesh->vert.size(), mesh->tris.data(), (int)mesh->tris.size() );
+	}
+	else {
+		if( vertNeeded > outMaxVert ) {
+			meshSoA->pos.resize( vertSize );
+			meshSoA->norm.resize( vertSize );
+		}
+		if( trisNeeded > outMaxTris )
+			meshSoA->tris.resize( trisSize );
+		_setOutput( meshSoA->pos.data(), meshSoA->norm.data(), (int)meshSoA->pos.size(),
+					meshSoA->tris.data(), (int)meshSoA->tris.size() );
+	}
+
+	outMesh		= mesh;
+	outMeshSoA	= meshSoA;
+	outVertBase	= vertBase;
+	outTriBase	= triBase;
+	return true;
+}
+
+void MarchingCubes::_streamCompact( int vertEnd, int triEnd )
+{
+	// the window is always a Mesh
+	Vertex* vert = outMesh->vert.data();
+	memmove( vert, vert + (vertEnd - outVertBase), (currentVertex - vertEnd) * sizeof(Vertex) );
+	memmove( outTris, outTris + (triEnd - outTriBase), (currentTriangle - triEnd) * sizeof(TriangleI) );
+	outVertBase = vertEnd;
+	outTriBase = triEnd;
+}
 
-	_cacheAlloc( field.getSizeX(), field.getSizeY(), field.getSizeZ() );
+int MarchingCubes::_fillField( int& vertexNum, int& triNum )
+{
+	_cacheAlloc( field->getSizeX(), field->getSizeY(), field->getSizeZ() );
 	_cacheClear();
 
     currentTriangle	= 0;
     currentVertex	= 0;
+    truncated		= false;
 
-    for( int x = 0; x < field.getSizeX()-1; x++ )
-    for( int y = 0; y < field.getSizeY()-1; y++ )
-    for( int z = 0; z < field.getSizeZ()-1; z++ )
-    {
-        Cube2 cube = field.getCube( x, y, z );
-		cube.setGridSize( field.getSizeX(), field.getSizeY(), field.getSizeZ() );
+	// the same order as the field is stored in memory, rolling cache also depends on z going outermost
+    for( int z = 0; z < field->getSizeZ()-1; z++ )
+		_marchLayer( z );
 
-		if( currentTriangle < maxTris - 10 ) {
-			TriangleF     tmpTris[10];
-			setValues( cube );
+    if( normalMode == NORMAL_TRIANGLES )
+		for( int v = 0; v < currentVertex; v++ )
+			_outNorm( v ).normalise();
 
-			MarchingCubesCase &cubeCase = getCaseFromValues();
-					usageStats[cubeCase.index]++;
+    vertexNum = currentVertex;
+    triNum = currentTriangle;
 
-			int triNum = 0;
-			// for each triangle
-			for( ; triNum < cubeCase.numTri; triNum++ )
-			{
-				// get triangle edges
-				// get cache indexes for all 3 edges
-				// if we had cache initialized - use this value
-				int e1 = cubeCase.tris[triNum][0];
-				int e2 = cubeCase.tris[triNum][1];
-				int e3 = cubeCase.tris[triNum][2];
-
-				int index1 = _cacheVertex( vert, x,y,z, e1 );
-				int index2 = _cacheVertex( vert, x,y,z, e2 );
-				int index3 = _cacheVertex( vert, x,y,z, e3 );
-
-				// get 3 resulting vertices
-				Vector3F vec1 = vert[index1].pos;
-				Vector3F vec2 = vert[index2].pos;
-				Vector3F vec3 = vert[index3].pos;
-
-//				Vector3F  delta1 = vec2 - vec1;
-//				Vector3F  delta2 = vec3 - vec1;
-
-//				Vector3F  normal;
-//				getCrossProduct( delta1.f, delta2.f, normal.f );
-
-				//	compute face normal
-				Vector3F  normal = getTriangleNormal( vec1, vec2, vec3 );
-
-				// Check for 0 or we get NaN errors
-				if( normal.isNotZero() ) {
-					normal.normalise();
-
-					// add normal to the cache
-					vert[index1].norm += normal;
-					vert[index2].norm += normal;
-					vert[index3].norm += normal;
-				}
+    return currentTriangle;
+}
 
-				tris[currentTriangle].i[0] = index1;
-				tris[currentTriangle].i[1] = index2;
-				tris[currentTriangle].i[2] = index3;
-				currentTriangle++;
+void MarchingCubes::_marchLayer( int z )
+{
+	int cubesX = field->getSizeX()-1;
+	int cubesY = field->getSizeY()-1;
+
+	// a sparse field is mostly bricks without the surface, so it's walked in bricks and the rest isn't touched at all
+	//		bricks go row by row, so -x and -y neighbours are done first, the same as tiles
+	if( field->getLayout() == VoxelField::LAYOUT_SPARSE && field->hasBrickIndex() )
+	{
+		int bz = z >> VoxelField::BRICK_SHIFT;
+		for( int by = 0; by < field->getBrickNumY(); by++ )
+		for( int bx = 0; bx < field->getBrickNumX(); bx++ )
+		{
+			int x0 = bx << VoxelField::BRICK_SHIFT;
+			int y0 = by << VoxelField::BRICK_SHIFT;
+			int x1 = min( x0 + VoxelField::BRICK_SIZE, cubesX );
+			int y1 = min( y0 + VoxelField::BRICK_SIZE, cubesY );
+
+			float brickMin = field->getBrickMin( bx, by, bz );
+			float brickMax = field->getBrickMax( bx, by, bz );
+			if( brickMax < isoValue || brickMin >= isoValue ) {
+				usageStats[ brickMax < isoValue ? 0 : 255 ] += (x1 - x0) * (y1 - y0);
+				continue;
 			}
+			for( int y = y0; y < y1; y++ )
+				_marchRow( y,z, x0,x1 );
+		}
+		return;
+	}
 
-			//*
-			if( cubeCase.capPlanes )
-			{
-				for( int plane = 0; plane < 6; plane++ )
-				{
-					int p = cubeCase.capPlanesTab[plane];
-					if( p != 0 )
-					{
-						int offset = _cacheOffsetFromPlane( x, y, z, plane );
-
-						std::map<int,int>::iterator cacheIter = capPlaneCache.find(offset);
-						if( cacheIter != capPlaneCache.end() )
-						{
-							int p2 = cacheIter->second;
-							capPlaneCache.erase( offset );
-
-							if( p2 == p )
-								_capPlane( vert, tris, x,y,z, plane, p );
-						}
-						else {
-							capPlaneCache.insert( std::pair<int,int>(offset, p) );
-						}
-					}
-				}
-			}//*/
-		}	// cur tri
-    }	//	for
+	if( traversalMode == TRAVERSAL_ROWS ) {
+		for( int y = 0; y < cubesY; y++ )
+			_marchRow( y,z );
+		return;
+	}
 
-//	int	lenVector[10] = {0};
+	// a tile starts after its -x and -y neighbours in Morton order, so cap planes still pair up
+	// and the cache needs only the planes of the current layer, the same as for rows
+	int tile = traversalTile;
+	_fillTileOrder( (cubesX + tile-1) / tile, (cubesY + tile-1) / tile );
 
-    for( int v = 0; v < currentVertex; v++ )
+	for( size_t t = 0; t < tileOrder.size(); t++ )
 	{
-//		if( vert[v].norm.length() < 0.5 ) {
-//			int x = 5;
-//		}
-//		if( vert[v].used < 10 ) {
-//			lenVector[ vert[v].used ] ++;
-//		}
-        vert[v].norm.normalise();
-    }
+		int x0 = tileOrder[t] & 0xffff;
+		int y0 = tileOrder[t] >> 16;
+		int x1 = min( x0 + tile, cubesX );
+		int y1 = min( y0 + tile, cubesY );
+		for( int y = y0; y < y1; y++ )
+			_marchRow( y,z, x0,x1 );
+	}
+}
 
-    vertexNum = currentVertex;
-    triNum = currentTriangle;
+void MarchingCubes::_fillTileOrder( int numX, int numY )
+{
+	if( numX == tileNumX && numY == tileNumY )
+		return;
+	tileNumX = numX;
+	tileNumY = numY;
+
+	// Morton code of a tile interleaves bits of its x and y, tiles outside of the layer are skipped
+	int bits = 0;
+	while( (1 << bits) < max( numX, numY ) )
+		bits++;
+
+	tileOrder.clear();
+	for( int m = 0; m < 1 << (2*bits); m++ )
+	{
+		int tx = 0, ty = 0;
+		for( int b = 0; b < bits; b++ ) {
+			tx |= ((m >> (2*b)) & 1) << b;
+			ty |= ((m >> (2*b+1)) & 1) << b;
+		}
+		if( tx < numX && ty < numY )
+			tileOrder.push_back( tx * traversalTile | (ty * traversalTile) << 16 );
+	}
+}
 
-    return currentTriangle;
+void MarchingCubes::_getRows( int y, int z, int x0, int x1, const float* rows[4] )
+{
+	int sizeX = field->getSizeX();
+	if( (int)rowBuffer.size() < 4*sizeX )
+		rowBuffer.resize( 4*sizeX );
+
+	for( int r = 0; r < 4; r++ )
+	{
+		int ry = y + (r & 1);
+		int rz = z + (r >> 1);
+		if( ry < field->getSizeY() && rz < field->getSizeZ() )
+			rows[r] = field->getRow( ry, rz, x0, x1, &rowBuffer[ r*sizeX ] );
+		else
+			rows[r] = NULL;
+	}
+}
+
+void MarchingCubes::_marchRow( int y, int z, int x0, int x1 )
+{
+	const float* rows[4];
+
+	bool bricks = field->hasBrickIndex();
+	int by = y >> VoxelField::BRICK_SHIFT;
+	int bz = z >> VoxelField::BRICK_SHIFT;
+
+	for( int x = x0; x < x1; )
+	{
+		int end = x1;
+
+		if( bricks )
+		{
+			int bx = x >> VoxelField::BRICK_SHIFT;
+			end = min( (bx+1) << VoxelField::BRICK_SHIFT, x1 );
+
+			// all corners of all cubes in the brick are on one side of the surface - case 0 or 255
+			float brickMin = field->getBrickMin( bx, by, bz );
+			float brickMax = field->getBrickMax( bx, by, bz );
+			if( brickMax < isoValue || brickMin >= isoValue ) {
+				usageStats[ brickMax < isoValue ? 0 : 255 ] += end - x;
+				x = end;
+				continue;
+			}
+		}
+
+		// only samples of cubes which weren't skipped, copying a bricked field isn't free
+		_getRows( y, z, x, end, rows );
+		_marchSpan( rows, y, z, x, end );
+		x = end;
+	}
 }
 
+void MarchingCubes::_marchSpan( const float* rows[4], int y, int z, int x0, int x1 )
+{
+	if( (int)rowCodes.size() < x1 - x0 )
+		rowCodes.resize( x1 - x0 );
+
+	unsigned char* codes = &rowCodes[0];
+	_classifyRow( rows, x0, x1, codes );
+
+	for( int x = x0; x < x1; x++, codes++ )
+	{
+		int code = *codes;
+		if( code == 0 || code == 255 ) {
+			usageStats[code]++;
+			continue;
+		}
+
+		for( int v = 0; v < 8; v++ )
+			vertex[v] = rows[v>>1][x + (v&1)];
 
-int MarchingCubes::_capPlane( MarchingCubes::Vertex* vert, MarchingCubes::TriangleI* tris,
-								int x, int y, int z, int plane, int side )
+		_marchCube( x,y,z, code );
+	}
+}
+
+void MarchingCubes::_marchRowCodes( int y, int z, const unsigned char* codes )
 {
-	int* edges = planeToEdge[plane];
+	int cubesX = field->getSizeX()-1;
+
+	const float* rows[4];
+	_getRows( y, z, 0, cubesX, rows );
+
+	for( int x = 0; x < cubesX; x++ )
+	{
+		int code = codes[x];
+		if( code == 0 || code == 255 ) {
+			usageStats[code]++;
+			continue;
+		}
+
+		for( int v = 0; v < 8; v++ )
+			vertex[v] = rows[v>>1][x + (v&1)];
+
+		_marchCube( x,y,z, code );
+	}
+}
+
+void MarchingCubes::_marchCube( int x, int y, int z, int code )
+{
+	if( !_reserveCube() )
+		return;
+
+
+	const MarchingCubesCase &cubeCase = table->triangleTable[code];
+			usageStats[code]++;
+
+	int triNum = 0;
+	// for each triangle
+	for( ; triNum < cubeCase.numTri; triNum++ )
+	{
+		// get triangle edges
+		// get cache indexes for all 3 edges
+		// if we had cache initialized - use this value
+		int e1 = cubeCase.tris[triNum][0];
+		int e2 = cubeCase.tris[triNum][1];
+		int e3 = cubeCase.tris[triNum][2];
+
+		int index1 = _cacheVertex( x,y,z, e1 );
+		int index2 = _cacheVertex( x,y,z, e2 );
+		int index3 = _cacheVertex( x,y,z, e3 );
+
+		// gradient normals are already set by _cacheVertex
+		if( normalMode == NORMAL_TRIANGLES )
+		{
+			// get 3 resulting vertices
+			Vector3F vec1 = _outPos( index1 );
+			Vector3F vec2 = _outPos( index2 );
+			Vector3F vec3 = _outPos( index3 );
+
+//			Vector3F  delta1 = vec2 - vec1;
+//			Vector3F  delta2 = vec3 - vec1;
+
+//			Vector3F  normal;
+//			getCrossProduct( delta1.f, delta2.f, normal.f );
+
+			//	compute face normal
+			Vector3F  normal = getTriangleNormal( vec1, vec2, vec3 );
+
+			// Check for 0 or we get NaN errors
+			if( normal.isNotZero() ) {
+				normal.normalise();
+
+				// add normal to the cache
+				_outNorm( index1 ) += normal;
+				_outNorm( index2 ) += normal;
+				_outNorm( index3 ) += normal;
+			}
+		}
+
+		_setTriangle( index1, index2, index3 );
+		currentTriangle++;
+	}
+
+	//*
+	if( cubeCase.capPlanes )
+	{
+		for( int plane = 0; plane < 6; plane++ )
+		{
+			int p = cubeCase.capPlanesTab[plane];
+			if( p != 0 )
+			{
+				CacheEntry* entry = _cacheEntryFromPlane( x, y, z, plane );
+
+				int p2 = entry->capPlane;
+				if( p2 != 0 )
+				{
+					// second cube of the pair, the plane is done
+					entry->capPlane = 0;
+
+					if( p2 == p )
+						_capPlane( x,y,z, plane, p );
+				}
+				else {
+					entry->capPlane = p;
+				}
+			}
+		}
+	}//*/
+}
 
-	int index[4];
-	for( int i = 0; i < 4; i++ )
-		index[i] = _cacheVertex( vert, x,y,z, edges[i] );
 
-	Vector3F vec1 = vert[ index[0] ].pos;
-	Vector3F vec2 = vert[ index[1] ].pos;
-	Vector3F vec3 = vert[ index[2] ].pos;
-	Vector3F vec4 = vert[ index[3] ].pos;
+void MarchingCubes::_capPlaneNormals( const int index[4], int side )
+{
+	Vector3F vec1 = _outPos( index[0] );
+	Vector3F vec2 = _outPos( index[1] );
+	Vector3F vec3 = _outPos( index[2] );
+	Vector3F vec4 = _outPos( index[3] );
 
 	Vector3F  normal21;
 	Vector3F  normal22;
@@ -192,37 +460,41 @@ int MarchingCubes::_capPlane( MarchingCubes::Vertex* vert, MarchingCubes::Triang
 	}
 
 	//*	// add normal to the cache
+	_outNorm( index[0] ) += normal;
+	_outNorm( index[1] ) += normal;
+	_outNorm( index[2] ) += normal;
+
+	_outNorm( index[1] ) += normal2;
+	_outNorm( index[2] ) += normal2;
+	_outNorm( index[3] ) += normal2;
+}
+
+int MarchingCubes::_capPlane( int x, int y, int z, int plane, int side )
+{
+	const int* edges = table->planeToEdge[plane];
 
-	vert[ index[0] ].norm += normal;
-	vert[ index[1] ].norm += normal;
-	vert[ index[2] ].norm += normal;
+	int index[4];
+	for( int i = 0; i < 4; i++ )
+		index[i] = _cacheVertex( x,y,z, edges[i] );
 
-	vert[ index[1] ].norm += normal2;
-	vert[ index[2] ].norm += normal2;
-	vert[ index[3] ].norm += normal2;
+	if( normalMode == NORMAL_TRIANGLES )
+		_capPlaneNormals( index, side );
 
 	if( side == -1 ) {
-		tris[currentTriangle].i[0] = index[0];
-		tris[currentTriangle].i[1] = index[1];
-		tris[currentTriangle].i[2] = index[2];
+		_setTriangle( index[0], index[1], index[2] );
 		currentTriangle++;
 
-		tris[currentTriangle].i[0] = index[1];
-		tris[currentTriangle].i[1] = index[3];
-		tris[currentTriangle].i[2] = index[2];
+		_setTriangle( index[1], index[3], index[2] );
 		currentTriangle++;
 	}
 	else if( side == 1 ) {
-		tris[currentTriangle].i[0] = index[0];
-		tris[currentTriangle].i[1] = index[2];
-		tris[currentTriangle].i[2] = index[1];
+		_setTriangle( index[0], index[2], index[1] );
 		currentTriangle++;
 
-		tris[currentTriangle].i[0] = index[1];
-		tris[currentTriangle].i[1] = index[2];
-		tris[currentTriangle].i[2] = index[3];
+		_setTriangle( index[1], index[2], index[3] );
 		currentTriangle++;
 	}
+	return 2;
 }
 
 
@@ -231,8 +503,8 @@ int MarchingCubes::_capPlane( MarchingCubes::Vertex* vert, MarchingCubes::Triang
 MarchingCubes::Vector3F MarchingCubes::getVertexFromEdge( int edgeNum )
 {
 	// get two vertex indices
-    int v1 = edgeToVertex[edgeNum][0];
-    int v2 = edgeToVertex[edgeNum][1];
+    int v1 = table->edgeToVertex[edgeNum][0];
+    int v2 = table->edgeToVertex[edgeNum][1];
 
 	// get current values for two vertices
     float vf1 = vertex[v1];
@@ -240,14 +512,14 @@ MarchingCubes::Vector3F MarchingCubes::getVertexFromEdge( int edgeNum )
 
     Vector3F result;
 
-    float v1x = vertexOffset[v1].f[0];
-    float v1y = vertexOffset[v1].f[1];
-    float v1z = vertexOffset[v1].f[2];
-    float v2x = vertexOffset[v2].f[0];
-    float v2y = vertexOffset[v2].f[1];
-    float v2z = vertexOffset[v2].f[2];
+    float v1x = table->vertexOffset[v1].f[0];
+    float v1y = table->vertexOffset[v1].f[1];
+    float v1z = table->vertexOffset[v1].f[2];
+    float v2x = table->vertexOffset[v2].f[0];
+    float v2y = table->vertexOffset[v2].f[1];
+    float v2z = table->vertexOffset[v2].f[2];
 
-    float perc = vf1/(vf1-vf2);
+    float perc = (vf1-isoValue)/(vf1-vf2);
     result.f[0] = v1x + (v2x-v1x) * perc;
     result.f[1] = v1y + (v2y-v1y) * perc;
     result.f[2] = v1z + (v2z-v1z) * perc;
@@ -255,6 +527,57 @@ MarchingCubes::Vector3F MarchingCubes::getVertexFromEdge( int edgeNum )
     return result;
 }
 
+MarchingCubes::Vector3F MarchingCubes::_fieldGradient( int x, int y, int z )
+{
+	int pos[3] = { x, y, z };
+	int size[3] = { field->getSizeX(), field->getSizeY(), field->getSizeZ() };
+
+	Vector3F grad;
+	for( int axis = 0; axis < 3; axis++ )
+	{
+		int lo[3] = { x, y, z };
+		int hi[3] = { x, y, z };
+		if( pos[axis] > 0 )
+			lo[axis]--;
+		if( pos[axis] < size[axis]-1 )
+			hi[axis]++;
+
+		float vLo, vHi;
+		field->getVal( lo[0], lo[1], lo[2], &vLo );
+		field->getVal( hi[0], hi[1], hi[2], &vHi );
+		grad.f[axis] = hi[axis] > lo[axis] ? (vHi - vLo) / (hi[axis] - lo[axis]) : 0.0f;
+	}
+	return grad;
+}
+
+MarchingCubes::Vector3F MarchingCubes::_gradientNormal( const Vector3F& pos )
+{
+	int corner[3];
+	int axis = -1;
+	float perc = 0.0f;
+	for( int i = 0; i < 3; i++ ) {
+		corner[i] = (int)pos.f[i];
+		if( pos.f[i] > corner[i] ) {
+			axis = i;
+			perc = pos.f[i] - corner[i];
+		}
+	}
+
+	Vector3F grad = _fieldGradient( corner[0], corner[1], corner[2] );
+	if( axis >= 0 ) {
+		corner[axis]++;
+		Vector3F grad2 = _fieldGradient( corner[0], corner[1], corner[2] );
+		for( int i = 0; i < 3; i++ )
+			grad.f[i] += (grad2.f[i] - grad.f[i]) * perc;
+	}
+
+	// values grow towards the inside, the normal points out
+	Vector3F normal( -grad.f[0], -grad.f[1], -grad.f[2] );
+	if( normal.isNotZero() )
+		normal.normalise();
+	return normal;
+}
+
 /*
 struct AxisVert {
     GLfloat pos[3];
@@ -1,39 +1,241 @@
 #include "VoxelField.h"
 #include "simplexnoise1234.h"
+#include <float.h>
 
 VoxelField::VoxelField()
 {
 	field = NULL;
-	planeSize = 0.0f;
+	layout = LAYOUT_LINEAR;
+	storageSize = 0;
+	mappedBase = NULL;
+	mappedSize = 0;
+	brickCount = 0;
+	pageFile = NULL;
+	sparseBackground = 0.0f;
+	pageBudget = 64 << 20;
+	pageFirst = pageLast = -1;
+	pageLoads = pageWrites = 0;
+	pageError = false;
+	sizeX = sizeY = sizeZ = 0;
+	planeSize = 0;
+	brickMin = brickMax = NULL;
+	brickNumX = brickNumY = brickNumZ = 0;
+	brickIndexEnabled = false;
+	allDirty = true;
 	setExtent( 10, 10, 10 );
 }
 
-VoxelField::VoxelField( int x, int y, int z )
+VoxelField::VoxelField( int x, int y, int z ) : VoxelField()
 {
-	VoxelField();
 	setSize( x, y, z );
 }
 
 VoxelField::~VoxelField()
 {
-	if( field )
-		delete[] field;
+	_storageFree();
+	_pageClose();
+	setBrickIndex( false );
 }
 
 void VoxelField::setSize( int x, int y, int z )
 {
-	if( field ) {
-		delete[] field;
-		field = 0;
-	}
+	bool bricks = brickIndexEnabled;
+	setBrickIndex( false );
+	brickIndexEnabled = bricks;
+
+	_storageFree();
 	if( x < 1 || y < 1 || z < 1 )
 		return;
 
+	_setDimensions( x, y, z );
+	_storageAlloc();
+
+	// new values aren't set yet, the index is filled by setVal
+	//		a sparse field already has its background everywhere
+	if( bricks ) {
+		_brickIndexAlloc();
+		if( layout == LAYOUT_SPARSE )
+			_sparseRebuildIndex();
+		else
+			_brickIndexClear();
+	}
+}
+
+void VoxelField::_setDimensions( int x, int y, int z )
+{
 	sizeX = x;
 	sizeY = y;
 	sizeZ = z;
 	planeSize = x*y;
-	field = new float[sizeX * sizeY * sizeZ];
+
+	// bricks cover cubes, there's one cube less than samples along each axis
+	brickNumX = max( sizeX - 2, 0 ) / BRICK_SIZE + 1;
+	brickNumY = max( sizeY - 2, 0 ) / BRICK_SIZE + 1;
+	brickNumZ = max( sizeZ - 2, 0 ) / BRICK_SIZE + 1;
+	dirty.assign( brickNumX * brickNumY * brickNumZ, 0 );
+	allDirty = true;
+}
+
+void VoxelField::_storageAlloc()
+{
+	if( layout == LAYOUT_LINEAR ) {
+		storageSize = (size_t)sizeX * sizeY * sizeZ;
+		field = new float[ storageSize ];
+		return;
+	}
+
+	int num[3] = {
+		(sizeX + BRICK_SIZE-1) >> BRICK_SHIFT,
+		(sizeY + BRICK_SIZE-1) >> BRICK_SHIFT,
+		(sizeZ + BRICK_SIZE-1) >> BRICK_SHIFT
+	};
+	vector<int>* morton[3] = { &mortonX, &mortonY, &mortonZ };
+
+	// bits of the 3 axes are interleaved as long as all of them have some left,
+	// so a long and thin field doesn't get a code range of a cube
+	int bits[3];
+	for( int a = 0; a < 3; a++ ) {
+		bits[a] = 0;
+		while( (1 << bits[a]) < num[a] )
+			bits[a]++;
+		morton[a]->assign( num[a], 0 );
+	}
+	int codeBit = 0;
+	for( int b = 0; b < max( bits[0], max( bits[1], bits[2] ) ); b++ )
+	for( int a = 0; a < 3; a++ )
+	{
+		if( b >= bits[a] )
+			continue;
+		for( int i = 0; i < num[a]; i++ )
+			(*morton[a])[i] |= ((i >> b) & 1) << codeBit;
+		codeBit++;
+	}
+
+	// every existing code gets the next brick, so bricks are stored in Morton order without holes
+	brickOrder.assign( 1 << codeBit, -1 );
+	for( int bz = 0; bz < num[2]; bz++ )
+	for( int by = 0; by < num[1]; by++ )
+	for( int bx = 0; bx < num[0]; bx++ )
+		brickOrder[ mortonX[bx] | mortonY[by] | mortonZ[bz] ] = 0;
+
+	brickCount = 0;
+	for( size_t code = 0; code < brickOrder.size(); code++ ) {
+		if( brickOrder[code] == 0 )
+			brickOrder[code] = brickCount++;
+	}
+	storageSize = (size_t)brickCount * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	if( layout == LAYOUT_PAGED )
+		_pageAlloc();
+	else if( layout == LAYOUT_SPARSE )
+		_sparseAlloc();
+	else
+		field = new float[ storageSize ];
+}
+
+void VoxelField::_storageFree()
+{
+	if( mappedBase ) {
+		_unmapFile();
+		field = NULL;
+	}
+	if( field ) {
+		delete[] field;
+		field = NULL;
+	}
+	// the file is kept for the next size
+	pageData.clear();
+	pageSlots.clear();
+	brickSlot.clear();
+	sparseSlot.clear();
+	sparseTile.clear();
+	sparseFree.clear();
+	// released, a sparse field shouldn't keep the memory of the largest one
+	vector<float>().swap( sparseBricks );
+	storageSize = 0;
+}
+
+void VoxelField::setLayout( Layout l )
+{
+	if( l == layout )
+		return;
+
+	if( !storageSize ) {
+		layout = l;
+		return;
+	}
+
+	// the old storage is read through the old layout and written through the new one
+	//		the paged one can't be held in memory anyway, so it's converted brick by brick
+	vector<float> values( l == LAYOUT_PAGED ? 0 : (size_t)sizeX * sizeY * sizeZ );
+	if( l != LAYOUT_PAGED ) {
+		for( int z = 0; z < sizeZ; z++ )
+		for( int y = 0; y < sizeY; y++ )
+		for( int x = 0; x < sizeX; x++ )
+			values[ (size_t)planeSize*z + sizeX*y + x ] = _load( _sampleOffset( x,y,z ) );
+	}
+	else if( layout != LAYOUT_BRICKED )
+		setLayout( LAYOUT_BRICKED );
+
+	// bricked and paged fields store the same bricks, only in different places
+	float* bricks = NULL;
+	if( layout == LAYOUT_BRICKED ) {
+		bricks = field;
+		field = NULL;
+	}
+	_storageFree();
+	layout = l;
+	_storageAlloc();
+
+	if( l == LAYOUT_PAGED ) {
+		const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+		for( int b = 0; b < brickCount; b++ ) {
+			memcpy( _pageIn( b, false ), bricks + (size_t)b * brickSize, brickSize * sizeof(float) );
+			pageSlots[ brickSlot[b] ].modified = true;
+		}
+		delete[] bricks;
+		return;
+	}
+	delete[] bricks;
+
+	for( int z = 0; z < sizeZ; z++ )
+	for( int y = 0; y < sizeY; y++ )
+	for( int x = 0; x < sizeX; x++ )
+		_store( _sampleOffset( x,y,z ), values[ (size_t)planeSize*z + sizeX*y + x ] );
+}
+
+void VoxelField::_gatherRow( int y, int z, int x0, int x1, float* buffer )
+{
+	// offset of the row inside its bricks and the Morton bits of y and z are the same for the whole row
+	int inner = ((z & (BRICK_SIZE-1)) << (2*BRICK_SHIFT)) + ((y & (BRICK_SIZE-1)) << BRICK_SHIFT);
+	int codeYZ = mortonY[y >> BRICK_SHIFT] | mortonZ[z >> BRICK_SHIFT];
+
+	const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	unique_lock<mutex> lock( pageMutex, defer_lock );
+	if( layout == LAYOUT_PAGED )
+		lock.lock();
+
+	for( int x = x0; x <= x1; )
+	{
+		int bx = x >> BRICK_SHIFT;
+		int end = min( (bx+1) << BRICK_SHIFT, x1+1 );
+		int brick = brickOrder[ mortonX[bx] | codeYZ ];
+
+		const float* src = NULL;
+		if( field )
+			src = field + (size_t)brick * brickSize;
+		else if( layout == LAYOUT_PAGED )
+			src = _pageIn( brick, true );
+		else if( sparseSlot[brick] >= 0 )
+			src = &sparseBricks[ (size_t)sparseSlot[brick] * brickSize ];
+
+		if( src )
+			memcpy( buffer + x, src + inner + (x & (BRICK_SIZE-1)), (end - x) * sizeof(float) );
+		else
+			fill( buffer + x, buffer + end, sparseTile[brick] );
+		x = end;
+	}
 }
 
 void VoxelField::setExtent( float x, float y, float z )
@@ -65,37 +267,152 @@ bool VoxelField::setVal( int x, int y, int z, float val )
 //		_outsideOf(z,0,sizeZ) )
 //		return false;
 
-	field[ planeSize*z + sizeX*y + x ] = val;
+	_store( _sampleOffset( x,y,z ), val );
+
+	if( !allDirty )
+		_markDirty( x, y, z );
+	if( brickMin )
+		_brickIndexUpdate( x, y, z, val );
 
 	return true;
 }
 
-void VoxelField::getVal( int x, int y, int z, float* val )
+void VoxelField::setAllValues( float val )
 {
-//	parameter checks, disabled for performance
-//	assert( field );
-//	if( !field )
-//		return false;
+	allDirty = true;
 
-//	if( _outsideOf(x,0,sizeX) ||
-//		_outsideOf(y,0,sizeY) ||
-//		_outsideOf(z,0,sizeZ) )
-//		return false;
+	if( field )
+		for( size_t i = 0; i < storageSize; i++ )
+			field[i] = val;
 
-	*val = field[ planeSize*z + sizeX*y + x ];
+	// no brick has to be allocated
+	if( layout == LAYOUT_SPARSE ) {
+		sparseSlot.assign( sparseSlot.size(), -1 );
+		sparseTile.assign( sparseTile.size(), val );
+		sparseFree.clear();
+		vector<float>().swap( sparseBricks );
+	}
+
+	// every brick is overwritten, so none has to be read from the file
+	for( int b = 0; !field && b < (int)brickSlot.size(); b++ )
+	{
+		lock_guard<mutex> lock( pageMutex );
+		float* data = _pageIn( b, false );
+		for( int i = 0; i < BRICK_SIZE * BRICK_SIZE * BRICK_SIZE; i++ )
+			data[i] = val;
+		pageSlots[ brickSlot[b] ].modified = true;
+	}
+
+	if( brickMin ) {
+		int brickNum = brickNumX * brickNumY * brickNumZ;
+		for( int i = 0; i < brickNum; i++ )
+			brickMin[i] = brickMax[i] = val;
+	}
 }
 
-void VoxelField::setAllValues( float val )
+void VoxelField::setBrickIndex( bool enable )
 {
-	if( field )
-		for( int i = 0; i < sizeX*sizeY*sizeZ; i++ )
-			field[i] = val;
+	if( brickMin ) {
+		delete[] brickMin;
+		delete[] brickMax;
+		brickMin = brickMax = NULL;
+	}
+
+	brickIndexEnabled = enable;
+	if( !enable || !storageSize )
+		return;
+
+	_brickIndexAlloc();
+	rebuildBrickIndex();
+}
+
+void VoxelField::_brickIndexAlloc()
+{
+	int brickNum = brickNumX * brickNumY * brickNumZ;
+	brickMin = new float[ brickNum ];
+	brickMax = new float[ brickNum ];
+}
+
+void VoxelField::rebuildBrickIndex()
+{
+	if( !brickMin )
+		return;
+
+	if( layout == LAYOUT_SPARSE ) {
+		_sparseRebuildIndex();
+		return;
+	}
+
+	_brickIndexClear();
+
+	for( int z = 0; z < sizeZ; z++ )
+	for( int y = 0; y < sizeY; y++ )
+	for( int x = 0; x < sizeX; x++ )
+		_brickIndexUpdate( x, y, z, _load( _sampleOffset( x,y,z ) ) );
+}
+
+void VoxelField::_brickIndexClear()
+{
+	// min > max, so the brick looks empty until some of its samples is set
+	int brickNum = brickNumX * brickNumY * brickNumZ;
+	for( int i = 0; i < brickNum; i++ ) {
+		brickMin[i] = FLT_MAX;
+		brickMax[i] = -FLT_MAX;
+	}
+}
+
+void VoxelField::_brickIndexUpdate( int x, int y, int z, float val )
+{
+	// sample at the brick border is also the last sample of the previous brick
+	int bx1 = min( x >> BRICK_SHIFT, brickNumX-1 );
+	int by1 = min( y >> BRICK_SHIFT, brickNumY-1 );
+	int bz1 = min( z >> BRICK_SHIFT, brickNumZ-1 );
+	int bx0 = (x > 0 && !(x & (BRICK_SIZE-1))) ? (x-1) >> BRICK_SHIFT : bx1;
+	int by0 = (y > 0 && !(y & (BRICK_SIZE-1))) ? (y-1) >> BRICK_SHIFT : by1;
+	int bz0 = (z > 0 && !(z & (BRICK_SIZE-1))) ? (z-1) >> BRICK_SHIFT : bz1;
+
+	for( int bz = bz0; bz <= bz1; bz++ )
+	for( int by = by0; by <= by1; by++ )
+	for( int bx = bx0; bx <= bx1; bx++ )
+	{
+		int b = (bz*brickNumY + by)*brickNumX + bx;
+		if( val < brickMin[b] )
+			brickMin[b] = val;
+		if( val > brickMax[b] )
+			brickMax[b] = val;
+	}
+}
+
+void VoxelField::clearDirty()
+{
+	allDirty = false;
+	memset( dirty.data(), 0, dirty.size() );
+}
+
+void VoxelField::_markDirty( int x, int y, int z )
+{
+	// cubes x-1 and x use the sample, cubes x-2 and x+1 share edges with them
+	int bx0 = max( x-2, 0 ) >> BRICK_SHIFT;
+	int by0 = max( y-2, 0 ) >> BRICK_SHIFT;
+	int bz0 = max( z-2, 0 ) >> BRICK_SHIFT;
+	int bx1 = min( min( x+1, sizeX-2 ) >> BRICK_SHIFT, brickNumX-1 );
+	int by1 = min( min( y+1, sizeY-2 ) >> BRICK_SHIFT, brickNumY-1 );
+	int bz1 = min( min( z+1, sizeZ-2 ) >> BRICK_SHIFT, brickNumZ-1 );
+
+	for( int bz = bz0; bz <= bz1; bz++ )
+	for( int by = by0; by <= by1; by++ )
+	for( int bx = bx0; bx <= bx1; bx++ )
+		dirty[ (bz*brickNumY + by)*brickNumX + bx ] = 1;
 }
 
 // this method gets proper values forming a cube and returns it in a helper class
 Cube2 VoxelField::getCube( int x, int y, int z )
 {
-	Cube2 c( field + planeSize*z + sizeX*y + x );
+	float corners[8];
+	for( int i = 0; i < 8; i++ )
+		corners[i] = _load( _sampleOffset( x + (i&1), y + ((i>>1)&1), z + ((i>>2)&1) ) );
+
+	Cube2 c( corners );
 	return c;
 }
 
@@ -104,14 +421,15 @@ Cube2 VoxelField::getCube( int x, int y, int z )
 //      but mathematically it's just a linear function of distance from center
 void VoxelField::addSphere( float fx, float fy, float fz, float frad )
 {
-	int startX = 0; //						max( 0.0f, fx-frad );
-	int startY = 0; //						max( 0.0f, fy-frad );
-	int startZ = 0; //						max( 0.0f, fz-frad );
-	int stopX  = sizeX; //						min( (float)sizeX, fx+frad );
-	int stopY  = sizeY; //						min( (float)sizeY, fy+frad );
-	int stopZ  = sizeZ; //						min( (float)sizeZ, fz+frad );
-
-	//we iterate over all points in voxel space
+	// only points closer than the radius are changed, so a small sphere costs only its bounding box
+	int startX = max( 0, (int)floorf( fx-frad ) );
+	int startY = max( 0, (int)floorf( fy-frad ) );
+	int startZ = max( 0, (int)floorf( fz-frad ) );
+	int stopX  = min( sizeX, (int)ceilf( fx+frad ) + 1 );
+	int stopY  = min( sizeY, (int)ceilf( fy+frad ) + 1 );
+	int stopZ  = min( sizeZ, (int)ceilf( fz+frad ) + 1 );
+
+	//we iterate over the points of the sphere's bounding box, clipped to the field
 	for( int xx = startX; xx < stopX; xx++ ) {
 		for( int yy = startY; yy < stopY; yy++ ) {
 			for( int zz = startZ; zz < stopZ; zz++ ) {
@@ -355,12 +673,18 @@ void VoxelField::setSpheres( float phase )
 	addSphere( x, z, y, rad );
 }
 
-void VoxelField::setPerlinNoise( int num )
+void VoxelField::setPerlinNoise( int )
 {
+	// every sample is overwritten, so the brick ranges can be computed from scratch
+	if( brickMin )
+		_brickIndexClear();
+	allDirty = true;
+
+	// in the storage order, so a paged field reads every brick once
 	float scale = 0.1f;
-	for( int xx = 0; xx < sizeX; xx++ ) {
+	for( int zz = 0; zz < sizeZ; zz++ ) {
 		for( int yy = 0; yy < sizeY; yy++ ) {
-			for( int zz = 0; zz < sizeZ; zz++ ) {
+			for( int xx = 0; xx < sizeX; xx++ ) {
 				float val = snoise3( (float)xx*scale, (float)yy*scale, (float)zz*scale );
 //				val += (1.0f/127.8f);
 				setVal( xx, yy, zz, val );
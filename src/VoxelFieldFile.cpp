@@ -0,0 +1,204 @@
+/*
+    VoxelField - raw volume files
+    Author: Karol Herda
+    Web:    http://kolenda.vipserv.org/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    The file is a RawHeader followed by sizeX*sizeY*sizeZ floats in the linear layout (planeSize*z + sizeX*y + x),
+    starting at dataOffset. Everything is stored in the native byte order, a file from a machine with
+    a different one fails the sampleType check.
+
+    openRaw maps the file, so opening doesn't depend on its size and pages are read when extraction gets to them.
+    The private mapping is copy-on-write, setVal copies only the pages it changes.
+    Windows doesn't get the mapping yet, the samples are read into memory there.
+*/
+
+#include "VoxelField.h"
+#include <limits.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const char		RAW_MAGIC[8]	= { 'M','C','V','O','L','U','M','E' };
+const unsigned	RAW_VERSION		= 1;
+// only float samples are supported, other values are reserved for integer scans
+const unsigned	RAW_FLOAT32		= 1;
+// samples start at a page boundary
+const unsigned	RAW_DATA_OFFSET	= 4096;
+
+struct RawHeader {
+	char		magic[8];
+	unsigned	version;
+	unsigned	sampleType;
+	int			size[3];
+	float		extent[3];
+	unsigned	dataOffset;
+	unsigned	reserved;
+};
+static_assert( sizeof(RawHeader) == 48, "RawHeader has to match the file" );
+
+bool rawHeaderValid( const RawHeader& header, size_t fileSize )
+{
+	if( memcmp( header.magic, RAW_MAGIC, sizeof(RAW_MAGIC) ) != 0 || header.version != RAW_VERSION )
+		return false;
+	if( header.sampleType != RAW_FLOAT32 || header.dataOffset < sizeof(RawHeader) || header.dataOffset % sizeof(float) )
+		return false;
+	if( header.size[0] < 1 || header.size[1] < 1 || header.size[2] < 1 )
+		return false;
+
+	// a crafted header mustn't wrap the sample count around, plane offsets of the field are ints too
+	const size_t maxCount = SIZE_MAX / sizeof(float);
+	if( (long long)header.size[0] * header.size[1] > INT_MAX )
+		return false;
+	size_t plane = (size_t)header.size[0] * header.size[1];
+	if( plane > maxCount || (size_t)header.size[2] > maxCount / plane )
+		return false;
+
+	size_t count = plane * header.size[2];
+	return fileSize >= header.dataOffset && (fileSize - header.dataOffset) / sizeof(float) >= count;
+}
+
+}
+
+bool VoxelField::openRaw( const char* path, bool writeBack )
+{
+	RawHeader header;
+	char* base = NULL;
+	size_t length = 0;
+
+#ifndef _WIN32
+	int fd = open( path, writeBack ? O_RDWR : O_RDONLY );
+	if( fd < 0 )
+		return false;
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || pread( fd, &header, sizeof(header), 0 ) != (ssize_t)sizeof(header) ||
+		!rawHeaderValid( header, (size_t)st.st_size ) ) {
+		close( fd );
+		return false;
+	}
+
+	length = header.dataOffset + (size_t)header.size[0] * header.size[1] * header.size[2] * sizeof(float);
+	void* mem = mmap( NULL, length, PROT_READ | PROT_WRITE, writeBack ? MAP_SHARED : MAP_PRIVATE, fd, 0 );
+	// the mapping keeps the file open
+	close( fd );
+	if( mem == MAP_FAILED )
+		return false;
+	base = (char*)mem;
+#else
+	if( writeBack )
+		return false;
+
+	FILE* file = fopen( path, "rb" );
+	if( !file )
+		return false;
+
+	size_t fileSize = 0;
+	if( _fseeki64( file, 0, SEEK_END ) == 0 )
+		fileSize = (size_t)_ftelli64( file );
+	if( _fseeki64( file, 0, SEEK_SET ) != 0 || fread( &header, sizeof(header), 1, file ) != 1 ||
+		!rawHeaderValid( header, fileSize ) ) {
+		fclose( file );
+		return false;
+	}
+
+	// read before the old storage is released, so a short read leaves the field as it was
+	size_t count = (size_t)header.size[0] * header.size[1] * header.size[2];
+	float* data = new float[ count ];
+	bool read = _fseeki64( file, header.dataOffset, SEEK_SET ) == 0 &&
+				fread( data, sizeof(float), count, file ) == count;
+	fclose( file );
+	if( !read ) {
+		delete[] data;
+		return false;
+	}
+#endif
+
+	bool bricks = brickIndexEnabled;
+	setBrickIndex( false );
+	_storageFree();
+	layout = LAYOUT_LINEAR;
+	_setDimensions( header.size[0], header.size[1], header.size[2] );
+
+#ifndef _WIN32
+	mappedBase = base;
+	mappedSize = length;
+	field = (float*)(base + header.dataOffset);
+	storageSize = (size_t)sizeX * sizeY * sizeZ;
+#else
+	// the linear storage _storageAlloc would allocate
+	field = data;
+	storageSize = count;
+	(void)base;
+	(void)length;
+#endif
+
+	setExtent( header.extent[0], header.extent[1], header.extent[2] );
+	// the index needs all samples, so it's the only thing reading the whole file up front
+	setBrickIndex( bricks );
+	return true;
+}
+
+void VoxelField::_unmapFile()
+{
+#ifndef _WIN32
+	munmap( mappedBase, mappedSize );
+#endif
+	mappedBase = NULL;
+	mappedSize = 0;
+}
+
+bool VoxelField::saveRaw( const char* path )
+{
+	if( !storageSize )
+		return false;
+
+	// written next to the target and renamed over it, the target may be the file mapped as this field
+	//		and truncating it would pull the samples from under the mapping
+	string tmpPath = string( path ) + ".tmp";
+	FILE* file = fopen( tmpPath.c_str(), "wb" );
+	if( !file )
+		return false;
+
+	RawHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, RAW_MAGIC, sizeof(RAW_MAGIC) );
+	header.version		= RAW_VERSION;
+	header.sampleType	= RAW_FLOAT32;
+	header.size[0]		= sizeX;
+	header.size[1]		= sizeY;
+	header.size[2]		= sizeZ;
+	header.extent[0]	= extentX;
+	header.extent[1]	= extentY;
+	header.extent[2]	= extentZ;
+	header.dataOffset	= RAW_DATA_OFFSET;
+
+	vector<char> padding( RAW_DATA_OFFSET - sizeof(header), 0 );
+	bool ok = fwrite( &header, sizeof(header), 1, file ) == 1 &&
+			  fwrite( &padding[0], 1, padding.size(), file ) == padding.size();
+
+	// rows come straight from the linear field or are gathered from bricks
+	vector<float> buffer( sizeX );
+	for( int z = 0; z < sizeZ && ok; z++ )
+	for( int y = 0; y < sizeY && ok; y++ )
+		ok = fwrite( getRow( y, z, 0, sizeX-1, &buffer[0] ), sizeof(float), sizeX, file ) == (size_t)sizeX;
+
+	ok = fclose( file ) == 0 && ok;
+#ifdef _WIN32
+	// rename doesn't replace an existing file there, the field is never mapped on Windows
+	if( ok )
+		remove( path );
+#endif
+	if( !ok || rename( tmpPath.c_str(), path ) != 0 ) {
+		remove( tmpPath.c_str() );
+		return false;
+	}
+	return true;
+}
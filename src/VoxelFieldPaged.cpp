@@ -0,0 +1,174 @@
+/*
+    VoxelField - paged layout
+    Author: Karol Herda
+    Web:    http://kolenda.vipserv.org/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Bricks of the field are stored in a file in the same order as in the bricked layout,
+    only pageBudget bytes of them are kept in memory. Extraction goes through the field in z layers,
+    so with a budget of two brick layers every brick is read once per fill.
+
+    Everything touching pages is done under pageMutex, so slab-parallel extraction can share the field.
+*/
+
+#include "VoxelField.h"
+
+static bool pageSeek( FILE* file, size_t offset )
+{
+#ifdef _WIN32
+	return _fseeki64( file, (__int64)offset, SEEK_SET ) == 0;
+#else
+	return fseeko( file, (off_t)offset, SEEK_SET ) == 0;
+#endif
+}
+
+bool VoxelField::setPaging( const char* path, size_t residentBytes )
+{
+	_pageClose();
+
+	pagePath = path ? path : "";
+	pageBudget = residentBytes;
+	pageFile = path ? fopen( path, "w+b" ) : tmpfile();
+	if( !pageFile ) {
+		pagePath.clear();
+		return false;
+	}
+	return true;
+}
+
+void VoxelField::_pageClose()
+{
+	if( !pageFile )
+		return;
+
+	fclose( pageFile );
+	pageFile = NULL;
+	if( !pagePath.empty() )
+		remove( pagePath.c_str() );
+	pagePath.clear();
+}
+
+void VoxelField::_pageAlloc()
+{
+	if( !pageFile )
+		pageFile = tmpfile();
+
+	const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+	int slots = (int)min( pageBudget / (brickSize * sizeof(float)), (size_t)brickCount );
+	slots = max( slots, 1 );
+
+	pageData.assign( (size_t)slots * brickSize, 0.0f );
+	pageSlots.resize( slots );
+	for( int s = 0; s < slots; s++ ) {
+		pageSlots[s].brick = -1;
+		pageSlots[s].modified = false;
+		pageSlots[s].prev = s-1;
+		pageSlots[s].next = s+1 < slots ? s+1 : -1;
+	}
+	pageFirst = 0;
+	pageLast = slots-1;
+
+	brickSlot.assign( brickCount, -1 );
+	pageLoads = pageWrites = 0;
+	pageError = false;
+}
+
+float* VoxelField::_pageIn( int brick, bool load )
+{
+	const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	int s = brickSlot[brick];
+	if( s < 0 )
+	{
+		// the least recently used slot gets the brick
+		s = pageLast;
+		PageSlot& slot = pageSlots[s];
+		if( slot.brick >= 0 ) {
+			// a failed write is only recorded, the slot is needed for the new brick
+			if( slot.modified )
+				_pageWrite( s );
+			brickSlot[ slot.brick ] = -1;
+		}
+		slot.brick = brick;
+		slot.modified = false;
+		brickSlot[brick] = s;
+
+		// parts of the file which were never written read as zeros
+		if( load ) {
+			float* data = &pageData[ (size_t)s * brickSize ];
+			size_t read = 0;
+			if( pageFile && pageSeek( pageFile, (size_t)brick * brickSize * sizeof(float) ) )
+				read = fread( data, sizeof(float), brickSize, pageFile );
+			memset( data + read, 0, (brickSize - read) * sizeof(float) );
+			pageLoads++;
+		}
+	}
+
+	// move to the front of the list
+	if( s != pageFirst )
+	{
+		PageSlot& slot = pageSlots[s];
+		pageSlots[ slot.prev ].next = slot.next;
+		if( slot.next >= 0 )
+			pageSlots[ slot.next ].prev = slot.prev;
+		else
+			pageLast = slot.prev;
+
+		slot.prev = -1;
+		slot.next = pageFirst;
+		pageSlots[ pageFirst ].prev = s;
+		pageFirst = s;
+	}
+	return &pageData[ (size_t)s * brickSize ];
+}
+
+bool VoxelField::_pageWrite( int s )
+{
+	const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	PageSlot& slot = pageSlots[s];
+	bool written = pageFile && pageSeek( pageFile, (size_t)slot.brick * brickSize * sizeof(float) ) &&
+				   fwrite( &pageData[ (size_t)s * brickSize ], sizeof(float), brickSize, pageFile ) == (size_t)brickSize;
+	// a resident brick stays modified, so the next flush tries it again
+	if( !written ) {
+		pageError = true;
+		return false;
+	}
+	slot.modified = false;
+	pageWrites++;
+	return true;
+}
+
+bool VoxelField::flushPages()
+{
+	lock_guard<mutex> lock( pageMutex );
+	bool written = true;
+	for( size_t s = 0; s < pageSlots.size(); s++ ) {
+		if( pageSlots[s].brick >= 0 && pageSlots[s].modified )
+			written &= _pageWrite( (int)s );
+	}
+	if( pageFile && fflush( pageFile ) != 0 ) {
+		pageError = true;
+		written = false;
+	}
+	// an evicted brick which failed before is lost even if everything resident got written now
+	return written && !pageError;
+}
+
+float VoxelField::_pageLoad( size_t offset )
+{
+	const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	lock_guard<mutex> lock( pageMutex );
+	return _pageIn( (int)(offset / brickSize), true )[ offset % brickSize ];
+}
+
+void VoxelField::_pageStore( size_t offset, float val )
+{
+	const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	lock_guard<mutex> lock( pageMutex );
+	int brick = (int)(offset / brickSize);
+	_pageIn( brick, true )[ offset % brickSize ] = val;
+	pageSlots[ brickSlot[brick] ].modified = true;
+}
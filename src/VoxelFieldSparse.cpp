@@ -0,0 +1,174 @@
+/*
+    VoxelField - sparse layout
+    Author: Karol Herda
+    Web:    http://kolenda.vipserv.org/algorithmic-marching-cubes/
+    Date:   12-03-2013
+
+    Bricks are addressed the same way as in the bricked layout, but only bricks with different samples
+    are allocated - the rest of the field is a grid of one value per brick. pruneSparse releases bricks
+    far from the surface, so a field kept as a narrow band around the surface costs memory proportional to its area.
+
+    With the brick index enabled extraction visits only bricks whose range crosses the surface,
+    see MarchingCubes::_marchLayer, and the index itself is rebuilt from tile values for bricks which aren't allocated.
+*/
+
+#include "VoxelField.h"
+#include <float.h>
+
+void VoxelField::_sparseAlloc()
+{
+	sparseSlot.assign( brickCount, -1 );
+	sparseTile.assign( brickCount, sparseBackground );
+	sparseFree.clear();
+	vector<float>().swap( sparseBricks );
+}
+
+void VoxelField::_sparseStore( size_t offset, float val )
+{
+	const int brickSize = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	size_t brick = offset >> (3*BRICK_SHIFT);
+	int slot = sparseSlot[brick];
+	if( slot < 0 )
+	{
+		if( val == sparseTile[brick] )
+			return;
+
+		// released slots are used first, the pool only grows when all are taken
+		if( !sparseFree.empty() ) {
+			slot = sparseFree.back();
+			sparseFree.pop_back();
+		}
+		else {
+			slot = (int)(sparseBricks.size() / brickSize);
+			sparseBricks.resize( sparseBricks.size() + brickSize );
+		}
+		fill( sparseBricks.begin() + (size_t)slot * brickSize, sparseBricks.begin() + (size_t)(slot+1) * brickSize, sparseTile[brick] );
+		sparseSlot[brick] = slot;
+	}
+	sparseBricks[ (size_t)slot * brickSize + (offset & (brickSize-1)) ] = val;
+}
+
+int VoxelField::pruneSparse( const float* isoValues, int isoNum, int ring )
+{
+	if( layout != LAYOUT_SPARSE || !storageSize )
+		return 0;
+
+	const float zero = 0.0f;
+	if( !isoValues ) {
+		isoValues = &zero;
+		isoNum = 1;
+	}
+	// some kept level has samples on both sides in [low,high]
+	auto crossed = [&]( float low, float high ) {
+		for( int l = 0; l < isoNum; l++ ) {
+			if( low < isoValues[l] && high >= isoValues[l] )
+				return true;
+		}
+		return false;
+	};
+
+	int num[3] = {
+		(sizeX + BRICK_SIZE-1) >> BRICK_SHIFT,
+		(sizeY + BRICK_SIZE-1) >> BRICK_SHIFT,
+		(sizeZ + BRICK_SIZE-1) >> BRICK_SHIFT
+	};
+
+	int released = 0;
+	for( int bz = 0; bz < num[2]; bz++ )
+	for( int by = 0; by < num[1]; by++ )
+	for( int bx = 0; bx < num[0]; bx++ )
+	{
+		int brick = brickOrder[ mortonX[bx] | mortonY[by] | mortonZ[bz] ];
+		if( sparseSlot[brick] < 0 )
+			continue;
+
+		// every cube using a sample of the brick has its corners in the brick or one sample around it,
+		//		gradients at the ends of their edges read one sample further
+		int x0 = max( (bx << BRICK_SHIFT) - ring, 0 ), x1 = min( ((bx+1) << BRICK_SHIFT) - 1 + ring, sizeX-1 );
+		int y0 = max( (by << BRICK_SHIFT) - ring, 0 ), y1 = min( ((by+1) << BRICK_SHIFT) - 1 + ring, sizeY-1 );
+		int z0 = max( (bz << BRICK_SHIFT) - ring, 0 ), z1 = min( ((bz+1) << BRICK_SHIFT) - 1 + ring, sizeZ-1 );
+
+		float low = FLT_MAX, high = -FLT_MAX;
+		bool surface = false;
+		double sum = 0.0;
+		int count = 0;
+		float brickLow = FLT_MAX, brickHigh = -FLT_MAX;
+
+		for( int z = z0; z <= z1 && !surface; z++ )
+		for( int y = y0; y <= y1 && !surface; y++ )
+		{
+			for( int x = x0; x <= x1; x++ )
+			{
+				float val = _sparseLoad( _sampleOffset( x,y,z ) );
+				low = min( low, val );
+				high = max( high, val );
+				if( (x >> BRICK_SHIFT) == bx && (y >> BRICK_SHIFT) == by && (z >> BRICK_SHIFT) == bz ) {
+					sum += val;
+					count++;
+					brickLow = min( brickLow, val );
+					brickHigh = max( brickHigh, val );
+				}
+			}
+			surface = crossed( low, high );
+		}
+		if( surface )
+			continue;
+
+		// the mean of the brick keeps values smooth for later edits, the samples around keep it on their side
+		//		of every level unless rounding moves it out of their range
+		float tile = min( max( (float)(sum / count), brickLow ), brickHigh );
+
+		sparseTile[brick] = tile;
+		sparseFree.push_back( sparseSlot[brick] );
+		sparseSlot[brick] = -1;
+		released++;
+	}
+
+	// ranges of released bricks changed, the index would still be correct, but it wouldn't be exact
+	if( released && brickMin )
+		_sparseRebuildIndex();
+	return released;
+}
+
+void VoxelField::_sparseRebuildIndex()
+{
+	for( int bz = 0; bz < brickNumZ; bz++ )
+	for( int by = 0; by < brickNumY; by++ )
+	for( int bx = 0; bx < brickNumX; bx++ )
+	{
+		// samples used by cubes of the brick, the last ones belong to the next bricks
+		int x0 = bx << BRICK_SHIFT, x1 = min( x0 + BRICK_SIZE, sizeX-1 );
+		int y0 = by << BRICK_SHIFT, y1 = min( y0 + BRICK_SIZE, sizeY-1 );
+		int z0 = bz << BRICK_SHIFT, z1 = min( z0 + BRICK_SIZE, sizeZ-1 );
+
+		float low = FLT_MAX;
+		float high = -FLT_MAX;
+		bool allocated = false;
+		for( int sz = z0 >> BRICK_SHIFT; sz <= z1 >> BRICK_SHIFT; sz++ )
+		for( int sy = y0 >> BRICK_SHIFT; sy <= y1 >> BRICK_SHIFT; sy++ )
+		for( int sx = x0 >> BRICK_SHIFT; sx <= x1 >> BRICK_SHIFT; sx++ )
+		{
+			int brick = brickOrder[ mortonX[sx] | mortonY[sy] | mortonZ[sz] ];
+			allocated |= sparseSlot[brick] >= 0;
+			low = min( low, sparseTile[brick] );
+			high = max( high, sparseTile[brick] );
+		}
+
+		if( allocated ) {
+			low = FLT_MAX;
+			high = -FLT_MAX;
+			for( int z = z0; z <= z1; z++ )
+			for( int y = y0; y <= y1; y++ )
+			for( int x = x0; x <= x1; x++ ) {
+				float val = _sparseLoad( _sampleOffset( x,y,z ) );
+				low = min( low, val );
+				high = max( high, val );
+			}
+		}
+
+		int b = (bz*brickNumY + by)*brickNumX + bx;
+		brickMin[b] = low;
+		brickMax[b] = high;
+	}
+}